@@ -0,0 +1,127 @@
+#include <iostream>         // cout
+#include <cstdlib>          // EXIT_FAILURE, atoi, atof
+#include <string>
+#include <vector>
+#include <chrono>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include "primitives.h"
+#include "vertex_layout.h"
+#include "mesh_file.h"
+#include "job_system.h"
+#include "obj_importer.h"
+
+using namespace std; // Standard namespace
+
+/*
+ * Converts meshes into the binary format of mesh_file.h, which Project2 maps
+ * and uploads without parsing (see the scene file's model lines):
+ *
+ *     MeshConverter <out.mesh> <box|plane|cylinder|sphere|pyramid> <x> <y> <z> [<segments> <min screen size>]...
+ *     MeshConverter <out.mesh> obj <file.obj>
+ *
+ * A primitive gets one level of detail per segments/min screen size pair
+ * (most detailed first, as in the scene file's lod lines), or a single level
+ * with the default segment count. An OBJ file becomes a single level of any
+ * size; files with a level over 65536 vertices store 32-bit indices.
+ */
+
+// Project2's SceneVertex, stripped to the attributes its shader reads, so the file uploads as is
+typedef VertexLayout<
+    VertexAttrib<0, VertexSemantic::Position, AttribFormat::Float3>,
+    VertexAttrib<1, VertexSemantic::Color, AttribFormat::UNorm8x4>,
+    VertexAttrib<2, VertexSemantic::TexCoord, AttribFormat::Half2>> MeshVertexLayout;
+const uint32_t SHADER_LOCATIONS = (1u << 0) | (1u << 2);
+
+bool UImportObj(const char* filename, ImportedMesh& mesh);
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        cout << "Usage: " << argv[0] << " <out.mesh> <box|plane|cylinder|sphere|pyramid> <x> <y> <z> [<segments> <min screen size>]..." << endl;
+        cout << "       " << argv[0] << " <out.mesh> obj <file.obj>" << endl;
+        return EXIT_FAILURE;
+    }
+    const char* output = argv[1];
+    string type = argv[2];
+
+    vector<ImportedMesh> meshes;
+    vector<float> minScreenSizes;
+    if (type == "obj")
+    {
+        meshes.resize(1);
+        minScreenSizes.push_back(0.0f);
+        if (!UImportObj(argv[3], meshes[0]))
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        if (argc < 6 || (argc - 6) % 2 != 0)
+        {
+            cout << "A primitive needs its size and then pairs of segments and min screen size" << endl;
+            return EXIT_FAILURE;
+        }
+        glm::vec3 size((float)atof(argv[3]), (float)atof(argv[4]), (float)atof(argv[5]));
+
+        // Without pairs, a single level with the scene file's default segment count
+        vector<int> segments;
+        for (int i = 6; i + 1 < argc; i += 2)
+        {
+            segments.push_back(atoi(argv[i]));
+            minScreenSizes.push_back((float)atof(argv[i + 1]));
+        }
+        if (segments.empty())
+        {
+            segments.push_back(16);
+            minScreenSizes.push_back(0.0f);
+        }
+
+        meshes.resize(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            MeshData generated;
+            if (!GeneratePrimitive(type, size, segments[i], generated))
+            {
+                cout << "Unknown primitive type " << type << endl;
+                return EXIT_FAILURE;
+            }
+            meshes[i].vertices.swap(generated.vertices);
+            meshes[i].indices.assign(generated.indices.begin(), generated.indices.end());
+        }
+    }
+
+    vector<MeshFileLevel> levels;
+    size_t triangles = 0;
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        levels.push_back(MeshFileLevel{ &meshes[i].vertices, &meshes[i].indices, minScreenSizes[i] });
+        triangles += meshes[i].indices.size() / 3;
+    }
+    if (!WriteMeshFile(output, MeshVertexLayout::Strip(SHADER_LOCATIONS), levels))
+        return EXIT_FAILURE;
+
+    cout << "Wrote " << output << ": " << levels.size() << " levels, " << triangles << " triangles" << endl;
+    return EXIT_SUCCESS;
+}
+
+
+// Imports an OBJ file on every core and reports the throughput
+bool UImportObj(const char* filename, ImportedMesh& mesh)
+{
+    JobSystem jobs;
+    jobs.Create();
+
+    ObjImportStats stats;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!ImportObj(filename, jobs, mesh, &stats))
+        return false;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    cout << "Imported " << filename << ": " << mesh.vertices.size() << " vertices welded from " << stats.corners << " corners, "
+         << stats.chunks << " chunks on " << jobs.ThreadCount() << " threads, " << stats.bytes / 1e6 / elapsed.count() << " MB/s" << endl;
+    return true;
+}
@@ -1,17 +1,44 @@
 #include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstdio>           // sscanf
+#include <cstring>          // strcmp
+#include <fstream>          // ifstream
+#include <sstream>          // istringstream
+#include <memory>           // unique_ptr
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "cylinder.h"
+#include "headless.h"
+#include "benchmark.h"
+#include "shader_program.h"
+#include "scene.h"
+#include "render_queue.h"
+#include "mesh_registry.h"
+#include "vertex_layout.h"
+#include "texture_loader.h"
+#include "profiler.h"
+#include "culling.h"
+#include "view_state.h"
+#include "primitives.h"
+#include "command_list.h"
+#include "job_system.h"
+#include "job_benchmark.h"
+#include "simulation.h"
+#include "presentation.h"
+#include "input_recording.h"
+#include "golden.h"
+#include "frame_capture.h"
+#include "mesh_file.h"
+#include "obj_importer.h"
+
+// After every header that includes stb_image.h, so the implementation is compiled once
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
 
 using namespace std; // Standard namespace
 
@@ -94,43 +121,62 @@ public:
     }
 
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix(bool ortho)
+    // (cached; only rebuilt after the camera moved, turned or entered ortho mode)
+    const glm::mat4& GetViewMatrix(bool ortho)
     {
-        if (ortho) {
+        // Ortho mode needs the vectors built around OrthoWorldUp
+        if (ortho && !vectorsOrtho)
             updateCameraVectors();
-            return glm::lookAt(Position, Position + Front, Up);
+        if (viewDirty) {
+            view = glm::lookAt(Position, Position + Front, Up);
+            viewDirty = false;
         }
-        else {
-            return glm::lookAt(Position, Position + Front, Up);
+        return view;
+    }
+
+    // increases whenever the view matrix changes; modify the camera through its methods so it does
+    unsigned GetVersion() const
+    {
+        return version;
+    }
+
+    // unit vector a movement key moves the camera along (up and down are flipped in ortho mode)
+    glm::vec3 MovementDirection(Camera_Movement direction) const
+    {
+        switch (direction) {
+        case FORWARD:   return Front;
+        case BACKWARD:  return -Front;
+        case LEFT:      return -Right;
+        case RIGHT:     return Right;
+        case UPWARD:    return ortho ? -Up : Up;
+        case DOWNWARD:  return ortho ? Up : -Up;
         }
+        return glm::vec3(0.0f);
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
         float velocity = MovementSpeed * deltaTime;
-        if (direction == FORWARD)
-            Position += Front * velocity;
-        if (direction == BACKWARD)
-            Position -= Front * velocity;
-        if (direction == LEFT)
-            Position -= Right * velocity;
-        if (direction == RIGHT)
-            Position += Right * velocity;
-        if (direction == UPWARD)
-            if (ortho) {
-                Position -= Up * velocity;
-            }
-            else {
-                Position += Up * velocity;
-            }
-        if (direction == DOWNWARD)
-            if (ortho) {
-                Position += Up * velocity;
-            }
-            else {
-                Position -= Up * velocity;
-            }
+        if (velocity != 0.0f)
+            SetPosition(Position + MovementDirection(direction) * velocity);
+    }
+
+    // turns the camera to the given Euler angles, in degrees
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
+    // moves the camera without turning it; the simulation places it here every frame
+    void SetPosition(const glm::vec3& position)
+    {
+        if (position == Position)
+            return;
+        Position = position;
+        markViewDirty();
     }
 
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
@@ -167,9 +213,23 @@ public:
     }
 
 private:
+    // cached view matrix and the state it was built from
+    glm::mat4 view;
+    bool viewDirty = true;
+    bool vectorsOrtho = false;
+    unsigned version = 0;
+
+    void markViewDirty()
+    {
+        viewDirty = true;
+        ++version;
+    }
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
+        markViewDirty();
+        vectorsOrtho = ortho;
         // calculate the new Front vector
         glm::vec3 front;
         front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
@@ -193,66 +253,273 @@ float lastX = WINDOW_WIDTH / 2.0f;
 float lastY = WINDOW_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// timing
-float deltaTime = 0.0f;	// time between current frame and last frame
-float lastFrame = 0.0f;
+// Everything that places the view: the camera's position and Euler angles (degrees) and the projection
+struct CameraPose
+{
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    bool ortho;
+};
+
+// Camera poses the golden mode (--golden) renders, named in the reference files
+struct GoldenView
+{
+    const char* name;
+    CameraPose pose;
+};
+const GoldenView GOLDEN_VIEWS[] = {
+    { "front", { glm::vec3(0.0f, 0.0f, 4.0f), -90.0f, 0.0f, false } },
+    { "side", { glm::vec3(4.0f, 1.0f, 0.0f), 180.0f, -14.0f, false } },
+    { "above", { glm::vec3(0.0f, 4.0f, 1.0f), -90.0f, -76.0f, false } },
+    { "ortho", { glm::vec3(0.0f, 0.0f, 4.0f), -90.0f, 0.0f, true } },
+};
+
+// Offscreen targets the batch mode (--batch) renders into in turn, so no image is drawn over one still being read back
+const int BATCH_TARGETS = 3;
+
+// Size of the default framebuffer, kept current by framebuffer_size_callback
+int framebufferWidth = WINDOW_WIDTH;
+int framebufferHeight = WINDOW_HEIGHT;
+
+// View, projection and frustum, rebuilt only when the camera, ortho mode or framebuffer size change
+ViewState viewState;
 
-// Stores the GL data relative to a given mesh
-struct GLMesh
+// Fixed-rate simulation of camera movement and spinning objects, on the main thread or its own.
+// Input goes in and states come out through triple buffers; each frame draws the last two ticks blended.
+struct SimulationInput
+{
+    glm::vec3 velocity = glm::vec3(0.0f);   // Camera movement from the keys held, units per second
+};
+struct SimulationFrame
+{
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    vector<float> spinAngles;               // Degrees, one per entry of spinningObjects
+};
+struct SimulationState
+{
+    double time = -1.0;                     // Clock time current stands for (see USimulationClock); negative before the first tick
+    SimulationFrame previous;
+    SimulationFrame current;
+};
+struct SpinningObject
+{
+    uint32_t draw;                          // Index into scene.objects and sceneDraws
+    Bounds meshBounds;                      // Model space
+};
+FixedTimestep simulationTimestep;
+SimulationThread simulationThread;
+TripleBuffer<SimulationInput> simulationInputs;     // Main thread to simulation
+TripleBuffer<SimulationState> simulationStates;     // Simulation to renderer
+SimulationState simulation;                         // Owned by whichever thread runs the ticks
+vector<SpinningObject> spinningObjects;
+
+// Input written to (--record) or played back from (--replay) a file. Single-threaded ticks are scheduled on a frame
+// clock that advances once per frame by the time since the last one, or by the recorded time on playback, so a
+// replay moves the camera through exactly the same ticks as the recorded run however fast it renders.
+InputRecorder inputRecorder;
+InputReplay inputReplay;
+size_t replayFrame = 0;             // Next frame of inputReplay
+double frameClock = 0.0;            // Seconds since the simulation started
+double lastClockSample = 0.0;       // SimulationNow() when frameClock last advanced
+
+// Every mesh lives in one shared vertex/index arena, sized for the scene's primitives and models
+// plus this much room for the hand-written meshes
+const GLuint BUILT_IN_MESH_VERTICES = 1024;
+const GLuint BUILT_IN_MESH_INDICES = 4096;
+MeshRegistry meshRegistry;
+
+// Everything the mesh creators describe; attributes the shader doesn't read are stripped when packing
+struct SceneVertex
 {
-    GLuint VAO;         // Handle for the vertex array object
-    GLuint VBO;         // Handle for the vertex buffer object
-    GLuint EBO;         // Handle for the element buffer object
-    GLuint nIndices;    // Number of indices of the mesh
+    typedef VertexLayout<
+        VertexAttrib<0, VertexSemantic::Position, AttribFormat::Float3>,
+        VertexAttrib<1, VertexSemantic::Color, AttribFormat::UNorm8x4>,
+        VertexAttrib<2, VertexSemantic::TexCoord, AttribFormat::Half2>> Layout;
 };
+PackedLayout meshLayout;
 
 // Mesh data
 GLMesh chestBodyMesh;
 GLMesh chestDecorMesh;
 GLMesh planeMesh;
 
-// Texture ID
-GLuint chestWoodTexture;
-GLuint chestMetalTexture;
-GLuint marbleTexture;
-GLuint pinkMarbleTexture;
-GLuint ornamentTexture;
+// Generated primitives and loaded models from the scene file, one arena range per level of detail (most detailed first)
+struct PrimitiveMesh
+{
+    string name;
+    vector<GLMesh> levels;
+    vector<float> minScreenSizes;   // Smallest projected height, as a fraction of the viewport, for each level
+    Bounds bounds;                  // Covers every level
+};
+vector<PrimitiveMesh> primitiveMeshes;
+
+// Scene meshes read before the arena exists, so it can be sized to hold all of them
+struct SceneMeshSources
+{
+    vector<MeshData> primitiveLevels;           // Every level of every primitive, in declaration order
+    vector<unique_ptr<MeshFile>> modelFiles;    // One per model; null for imported ones
+    vector<ImportedMesh> importedModels;        // One per model; empty for mapped ones
+    size_t vertexCount = 0;
+    size_t indexCount = 0;                      // In GLushort slots of the arena; a GLuint index takes two
+};
+
+// Scene description, its textures (same order as scene.textures) and one prepared draw per object
+Scene scene;
+vector<GLuint> sceneTextures;
+vector<DrawItem> sceneDraws;
+vector<int> sceneLods;          // Index into primitiveMeshes for each draw, -1 for fixed meshes
+RenderQueue renderQueue;
+
+// World-space bounds of each draw; scenes this large are culled through a hierarchy instead of a linear scan
+const size_t BVH_MIN_OBJECTS = 2048;
+vector<Bounds> sceneBounds;
+
+// Contiguous ranges of the scene's draws, culled and recorded in parallel as jobs;
+// smaller scenes use fewer partitions, down to a single one recorded on the GL thread
+const size_t MIN_PARTITION_OBJECTS = 512;
+struct ScenePartition
+{
+    uint32_t first = 0;
+    uint32_t count = 0;
+    BoundingVolumeHierarchy hierarchy;  // Over this partition's bounds, in large scenes
+    vector<uint32_t> visible;           // Scene draw indices that passed culling this frame
+    CommandList commands;
+};
+vector<ScenePartition> scenePartitions;
 
-// Shader program
-GLuint shaderProgramId;
+// Runs the CPU-side stages (primitive generation, culling and recording) across every core
+JobSystem jobs;
+
+// Decodes the scene's images in the background; objects show a placeholder until theirs is uploaded
+TextureLoader textureLoader;
+
+// Named CPU/GPU zones, recorded only when --profile is given
+Profiler profiler;
+
+// Shader program, linked from a binary cached by an earlier run when the driver accepts it
+ShaderProgram shaderProgram;
+ProgramBinaryCache programCache;
+
+// Reads back every frame for --capture and writes it out on a thread of its own
+FrameCapture frameCapture;
+
+// Camera matrices shared by every program through a uniform buffer
+CameraUniformBuffer cameraBuffer;
+
+// Options selected on the command line
+struct RunOptions
+{
+    bool headless = false;          // Render offscreen instead of into a window
+    int frames = 500;               // Measured frames in headless mode
+    int warmupFrames = 10;          // Unmeasured frames rendered before the benchmark
+    int width = WINDOW_WIDTH;       // Offscreen framebuffer width
+    int height = WINDOW_HEIGHT;     // Offscreen framebuffer height
+    const char* sceneFile = "chest.scene";
+    const char* profileFile = nullptr;  // Chrome trace written on exit, when set
+    int jobBenchmarkObjects = 0;    // When set, only run the job system benchmark on this many objects
+    double tickRate = 60.0;         // Simulation ticks per second
+    bool simulationThread = false;  // Tick on a thread of its own instead of between frames
+    PresentMode presentMode = PresentMode::Vsync;
+    double frameRateLimit = 60.0;   // Frames per second in PresentMode::Limit
+    const char* recordFile = nullptr;   // Input of the windowed run written here, when set
+    const char* replayFile = nullptr;   // Input played back from here instead of the keyboard and mouse, when set
+    const char* goldenDirectory = nullptr;  // Reference images and timings to check against (or write), when set
+    bool goldenUpdate = false;      // Write the golden references instead of checking them
+    const char* batchFile = nullptr;    // Camera poses to render one image each of, when set
+    const char* capturePrefix = nullptr;    // Every frame is written out under this name, when set
+    CaptureFormat captureFormat = CaptureFormat::Ppm;
+};
 
 /* User-defined Function prototypes to:
  * initialize the program, set the window size,
  * redraw graphics on the window when resized,
  * and render graphics on the screen
  */
-void UProcessInput(GLFWwindow* window);
-void UCreateChestBodyMesh(GLMesh& mesh);
-void UCreateChestDecorMesh(GLMesh& mesh);
-void UCreatePlaneMesh(GLMesh& mesh);
-void UDestroyMesh(GLMesh& mesh);
-bool UCreateTexture(const char* filename, GLuint& textureId);
+bool UParseArguments(int argc, char* argv[], RunOptions& options);
+int URunWindowed(const RunOptions& options);
+int URunHeadless(const RunOptions& options);
+bool URunGolden(const RunOptions& options);
+bool URunBatch(const RunOptions& options);
+bool ULoadPoses(const char* filename, vector<CameraPose>& poses);
+void UApplyPose(const CameraPose& pose);
+bool UCreateScene(const char* sceneFile);
+bool UCreateMeshArena(size_t sceneVertices, size_t sceneIndices);
+bool UFindSceneMesh(const string& name, DrawItem& item, Bounds& bounds, int& primitive);
+void UUseMesh(const GLMesh& mesh, DrawItem& item);
+bool UAddInterleavedMesh(const GLfloat* vertices, GLuint vertexCount, const GLushort* indices, GLuint indexCount, GLMesh& mesh);
+bool UAddSourceMesh(const vector<SourceVertex>& vertices, const vector<GLushort>& indices, GLMesh& mesh);
+bool UAddSourceMesh(const vector<SourceVertex>& vertices, const vector<uint32_t>& indices, GLMesh& mesh);
+void UPackSourceMesh(const vector<SourceVertex>& vertices, vector<unsigned char>& packed, GLMesh& mesh);
+size_t UIndexSlots(size_t vertexCount, size_t indexCount);
+bool UGeneratePrimitives(SceneMeshSources& sources);
+bool UOpenModels(SceneMeshSources& sources);
+bool UAddPrimitiveMeshes(const SceneMeshSources& sources);
+bool UAddModels(const SceneMeshSources& sources);
+bool URepackVertices(const PackedLayout& layout, const void* vertices, GLuint vertexCount, vector<unsigned char>& packed);
+size_t USelectLod(const PrimitiveMesh& primitive, const Bounds& bounds, const ViewState& view);
+void UDestroyScene();
+bool UFinishTextureLoads();
+void UStartProfile(const RunOptions& options);
+void UFinishProfile(const RunOptions& options);
+glm::mat4 UGetProjection(bool isOrtho, int width, int height);
+void UUpdateViewState(int width, int height);
+RenderStats URenderScene(const ViewState& view);
+void UCreatePartitions();
+void URecordPartition(ScenePartition& partition, const ViewState& view);
+unsigned UProcessInput(GLFWwindow* window);
+void UApplyHeldKeys(unsigned heldKeys);
+void UHandleInput(const InputEvent& event);
+void UApplyInput(const InputEvent& event);
+bool UStartInput(const RunOptions& options);
+void UStopInput();
+bool USampleInput(GLFWwindow* window);
+void UStartSimulation(const RunOptions& options);
+void UStopSimulation();
+double USimulationClock();
+void UStepSimulation();
+void USimulationTick(double tickTime);
+void UApplySimulation();
+void UMoveDraw(uint32_t index, const glm::mat4& model, const Bounds& meshBounds);
+bool UCreateChestBodyMesh(GLMesh& mesh);
+bool UCreateChestDecorMesh(GLMesh& mesh);
+bool UCreatePlaneMesh(GLMesh& mesh);
 void UDestroyTexture(GLuint textureId);
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
-void UDestroyShaderProgram(GLuint programId);
 
 
 /* Vertex Shader Source Code*/
 const GLchar* vertexShaderSource = GLSL(440,
     layout(location = 0) in vec3 position;
     layout(location = 2) in vec2 textureCoordinate;
+    layout(location = 3) in uint drawId;            // Per-instance index into draws
 
     out vec2 vertexTextureCoordinate;
+    flat out int vertexFlags;
 
     //Global variables for the transform matrices
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
+    layout(std140, binding = 0) uniform CameraBlock
+    {
+        mat4 view;
+        mat4 projection;
+    };
+
+    // Per-draw model matrix and flags (1 = blend the extra texture), written once per frame by the render queue
+    struct DrawData
+    {
+        mat4 model;
+        int flags;
+    };
+    layout(std430, binding = 0) readonly buffer DrawBlock
+    {
+        DrawData draws[];
+    };
 
     void main()
     {
-        gl_Position = projection * view * model * vec4(position, 1.0f); // transforms vertices to clip coordinates
+        DrawData draw = draws[drawId];
+        gl_Position = projection * view * draw.model * vec4(position, 1.0f); // transforms vertices to clip coordinates
         vertexTextureCoordinate = textureCoordinate;
+        vertexFlags = draw.flags;
     }
 );
 
@@ -260,17 +527,17 @@ const GLchar* vertexShaderSource = GLSL(440,
 /* Fragment Shader Source Code*/
 const GLchar* fragmentShaderSource = GLSL(440,
     in vec2 vertexTextureCoordinate;
+    flat in int vertexFlags;
 
     out vec4 fragmentColor;
 
     uniform sampler2D uTextureBase;
     uniform sampler2D uTextureExtra;
-    uniform bool multipleTextures;
 
     void main()
     {
         fragmentColor = texture(uTextureBase, vertexTextureCoordinate);
-        if (multipleTextures)
+        if (vertexFlags != 0)
         {
             vec4 extraTexture = texture(uTextureExtra, vertexTextureCoordinate);
             if (extraTexture.a != 0.0)
@@ -279,27 +546,137 @@ const GLchar* fragmentShaderSource = GLSL(440,
     }
 );
 
-// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
-void flipImageVertically(unsigned char* image, int width, int height, int channels)
+int main(int argc, char* argv[])
 {
-    for (int j = 0; j < height / 2; ++j)
+    // Command line options
+    // --------------------
+    // --headless           render offscreen (EGL) and print frame time statistics
+    // --frames N           number of measured frames in headless mode
+    // --size WxH           offscreen framebuffer resolution
+    // --scene FILE         scene description to render (default chest.scene)
+    // --profile FILE       record CPU/GPU zones and write them as a Chrome trace
+    // --job-benchmark N    time culling and recording N synthetic objects against thread count (no GL)
+    // --tick-rate HZ       simulation ticks per second (default 60)
+    // --sim-thread         run the simulation on its own thread
+    // --present MODE       vsync (default), uncapped, limit or low-latency (see presentation.h)
+    // --fps N              frame rate of the limit mode (default 60)
+    // --record FILE        write the keyboard and mouse input of the run to FILE
+    // --replay FILE        play back input recorded with --record; with --headless, benchmarks exactly its frames
+    // --golden DIR         render fixed views headless and compare images, frame times and draw calls with DIR
+    // --golden-update      write the references in the --golden directory instead of comparing
+    // --batch FILE         render one image per camera pose in FILE, headless, as fast as possible (see ULoadPoses)
+    // --capture PREFIX     write every rendered frame as PREFIX_NNNNNN.ppm, or to PREFIX.rgba with --capture-format raw
+    // --capture-format F   ppm (default) or raw (see frame_capture.h)
+    RunOptions options;
+    if (!UParseArguments(argc, argv, options))
+        return EXIT_FAILURE;
+
+    if (options.jobBenchmarkObjects > 0)
     {
-        int index1 = j * width * channels;
-        int index2 = (height - 1 - j) * width * channels;
+        JobBenchmark benchmark(options.jobBenchmarkObjects, options.frames);
+        benchmark.Run(cout);
+        return EXIT_SUCCESS;
+    }
+
+    int result = options.headless ? URunHeadless(options) : URunWindowed(options);
 
-        for (int i = width * channels; i > 0; --i)
+    exit(result); // Terminates the program
+}
+
+
+// Parses the command line into the run options
+bool UParseArguments(int argc, char* argv[], RunOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+            options.headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            options.frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            options.warmupFrames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            options.sceneFile = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            options.profileFile = argv[++i];
+        else if (strcmp(argv[i], "--job-benchmark") == 0 && i + 1 < argc)
+            options.jobBenchmarkObjects = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+            options.tickRate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--sim-thread") == 0)
+            options.simulationThread = true;
+        else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc && ParsePresentMode(argv[i + 1], options.presentMode))
+            ++i;
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            options.frameRateLimit = atof(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            options.recordFile = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            options.replayFile = argv[++i];
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+        {
+            options.goldenDirectory = argv[++i];
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--golden-update") == 0)
+            options.goldenUpdate = true;
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            options.batchFile = argv[++i];
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            options.capturePrefix = argv[++i];
+        else if (strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc && ParseCaptureFormat(argv[i + 1], options.captureFormat))
+            ++i;
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2)
+            {
+                cout << "Invalid size " << argv[i] << ", expected WIDTHxHEIGHT" << endl;
+                return false;
+            }
+        }
+        else
         {
-            unsigned char tmp = image[index1];
-            image[index1] = image[index2];
-            image[index2] = tmp;
-            ++index1;
-            ++index2;
+            cout << "Usage: " << argv[0] << " [--headless] [--frames N] [--warmup N] [--size WxH] [--scene FILE] [--profile FILE] [--job-benchmark N] [--tick-rate HZ] [--sim-thread]"
+                 << " [--present vsync|uncapped|limit|low-latency] [--fps N] [--record FILE] [--replay FILE]"
+                 << " [--golden DIR [--golden-update]] [--batch FILE] [--capture PREFIX] [--capture-format ppm|raw]" << endl;
+            return false;
         }
     }
+
+    if (options.frames <= 0 || options.warmupFrames < 0 || options.width <= 0 || options.height <= 0 || options.tickRate <= 0.0 || options.frameRateLimit <= 0.0)
+    {
+        cout << "Frame count, size, tick rate and frame rate must be positive" << endl;
+        return false;
+    }
+    if (options.goldenUpdate && !options.goldenDirectory)
+    {
+        cout << "--golden-update needs --golden DIR" << endl;
+        return false;
+    }
+    if (options.batchFile && (options.goldenDirectory || options.replayFile))
+    {
+        cout << "--batch cannot be combined with --golden or --replay" << endl;
+        return false;
+    }
+    if (options.recordFile && (options.replayFile || options.headless))
+    {
+        cout << "--record needs a windowed run without --replay" << endl;
+        return false;
+    }
+    if ((options.recordFile || options.replayFile) && options.simulationThread)
+    {
+        cout << "--record and --replay need the simulation on the main thread, without --sim-thread" << endl;
+        return false;
+    }
+    return true;
 }
 
 
-int main(int argc, char* argv[])
+// Interactive mode: renders into a GLFW window and reacts to keyboard and mouse
+int URunWindowed(const RunOptions& options)
 {
     // GLFW: initialize and configure
     // ------------------------------
@@ -323,6 +700,7 @@ int main(int argc, char* argv[])
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetKeyCallback(window, key_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -330,10 +708,6 @@ int main(int argc, char* argv[])
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-
     // GLEW: initialize
     // ----------------
     // Note: if using GLEW version 1.13 or earlier
@@ -343,582 +717,1271 @@ int main(int argc, char* argv[])
     if (GLEW_OK != GlewInitResult)
     {
         std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
-        return false;
+        return EXIT_FAILURE;
     }
 
     // Displays GPU OpenGL version
     cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
 
-    // Create the mesh
-    UCreateChestBodyMesh(chestBodyMesh);
-    UCreateChestDecorMesh(chestDecorMesh);
-    UCreatePlaneMesh(planeMesh);
-
-    // Cylinder
-    static_meshes_3D::Cylinder cylinder(0.25, 20, 1.0, true, true, true);
-    unsigned int cylinderVAO, cylinderVBO;
-
-    glGenVertexArrays(1, &cylinderVAO);
-    glBindVertexArray(cylinderVAO);
-    glGenBuffers(1, &cylinderVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-
-
-    // Create the shader program
-    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, shaderProgramId))
+    UStartProfile(options);
+    if (!UCreateScene(options.sceneFile))
         return EXIT_FAILURE;
 
-    // Load textures
-    const char* texFilename = "wood.jpg";
-    if (!UCreateTexture(texFilename, chestWoodTexture))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    texFilename = "metal.jpg";
-    if (!UCreateTexture(texFilename, chestMetalTexture))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    texFilename = "marble.gif";
-    if (!UCreateTexture(texFilename, marbleTexture))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-    texFilename = "pinkMarble.jpg";
-    if (!UCreateTexture(texFilename, pinkMarbleTexture))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
+    if (!UStartInput(options))
         return EXIT_FAILURE;
-    }
-    texFilename = "ornament.jpg";
-    if (!UCreateTexture(texFilename, ornamentTexture))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
+    if (options.capturePrefix && !frameCapture.Create(options.capturePrefix, options.captureFormat))
         return EXIT_FAILURE;
-    }
-    // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    glUseProgram(shaderProgramId);
+    UStartSimulation(options);
 
-    glUniform1i(glGetUniformLocation(shaderProgramId, "uTextureBase"), 0);
-    glUniform1i(glGetUniformLocation(shaderProgramId, "uTextureExtra"), 1);
+    // Frame pacing; every mode reports its frame times and input-to-submit latency on exit
+    PresentPacer pacer;
+    pacer.Create(options.presentMode, options.frameRateLimit);
+    glfwSwapInterval(pacer.SwapInterval());
 
-            
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        {
+            CpuZone zone(profiler, "WaitForFrame");
+            pacer.WaitForFrame();
+        }
+        profiler.BeginFrame();
+        CpuZone frameZone(profiler, "Frame");
 
-        // input
+        // input, then the simulation ticks due by now and the state to draw
         // -----
-        UProcessInput(window);
-
-        // Clear the frame and z buffers
-        glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                
-        // Retrieves and passes transform matrices to the Shader program
-        GLint viewLoc = glGetUniformLocation(shaderProgramId, "view");
-        GLint projLoc = glGetUniformLocation(shaderProgramId, "projection");
-        GLint modelLoc = glGetUniformLocation(shaderProgramId, "model");
-        GLuint multipleTexturesLoc = glGetUniformLocation(shaderProgramId, "multipleTextures");
-
-        // camera/view transformation
-        glm::mat4 view = camera.GetViewMatrix(ortho);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-        glm::mat4 projection;
-        // Creates a perspective projection
-        // Condition if orthographic
-        if (ortho) {
-            float scale = 200;
-            float scaledWidth = (GLfloat)WINDOW_WIDTH / scale;
-            float scaledHeight = (GLfloat)WINDOW_HEIGHT/ scale;
-            projection = glm::ortho(-scaledWidth, scaledWidth, scaledHeight, -scaledHeight, -4.0f, 10.0f);
-        }
-        else {
-            projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-        }
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Render Chest
-        glm::mat4 scale = glm::scale(glm::vec3(1.5f, 2.0f, 2.0f));
-        glm::mat4 rotation = glm::rotate(-3.141592f * 0.15f, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 translation = glm::translate(glm::vec3(0.0f, 0.0f, 0.0f));
-        glm::mat4 model = translation * rotation * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        
-        // Activate the VBOs contained within the mesh's VAO, draw elements, and deactivate the VAO
-        glUniform1i(multipleTexturesLoc, false);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, chestWoodTexture);
-        glBindVertexArray(chestBodyMesh.VAO);
-        glDrawElements(GL_TRIANGLES, chestBodyMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        translation = glm::translate(glm::vec3(0.0f, 0.39f, 0.0f));
-        model = translation * rotation * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(multipleTexturesLoc, false);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, chestMetalTexture);
-        glBindVertexArray(chestDecorMesh.VAO);
-        glDrawElements(GL_TRIANGLES, chestDecorMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-       
-        // Render Cylinder
-        scale = glm::scale(glm::vec3(1.0f, 1.5f, 2.0f));
-        translation = glm::translate(glm::vec3(0.0f, 0.5f, 0.0f));
-        glm::mat4 rotationZ = glm::rotate(-3.141592f * 0.5f, glm::vec3(0.0f, 0.0f, 1.0f));
-        model = translation * rotation * rotationZ * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(multipleTexturesLoc, false);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, chestWoodTexture);
-        glBindVertexArray(cylinderVAO);
-        cylinder.render();
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        // Pink Marble box
-        scale = glm::scale(glm::vec3(0.6f, 0.4f, 0.6f));
-        translation = glm::translate(glm::vec3(-1.0f, -0.4f, 1.0f));
-        rotation = glm::rotate(-3.141592f * -0.15f, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = translation * rotation * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(multipleTexturesLoc, false);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pinkMarbleTexture);
-        glBindVertexArray(chestBodyMesh.VAO);
-        glDrawElements(GL_TRIANGLES, chestBodyMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        // Pink Marble box lid
-        scale = glm::scale(glm::vec3(0.62f, 0.15f, 0.62f));
-        translation = glm::translate(glm::vec3(-1.0f, -0.31f, 1.0f));
-        rotation = glm::rotate(-3.141592f * -0.15f, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = translation * rotation * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(multipleTexturesLoc, false);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pinkMarbleTexture);
-        glBindVertexArray(chestBodyMesh.VAO);
-        glDrawElements(GL_TRIANGLES, chestBodyMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        // Top pink marble box
-        scale = glm::scale(glm::vec3(0.62f, 0.0f, 0.32f));
-        translation = glm::translate(glm::vec3(-1.0f, -0.27f, 1.0f));
-        rotation = glm::rotate(-3.141592f * -0.15f, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = translation * rotation * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(multipleTexturesLoc, true);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pinkMarbleTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, ornamentTexture);
-        glBindVertexArray(planeMesh.VAO);
-        glDrawElements(GL_TRIANGLES, planeMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        // Render Plane
-        scale = glm::scale(glm::vec3(10.0f, 10.0f, 10.0f));
-        translation = glm::translate(glm::vec3(0.0f, -0.5f, 0.0f));
-        model = translation * rotation * scale;
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform1i(multipleTexturesLoc, false);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, marbleTexture);
-        glBindVertexArray(planeMesh.VAO);
-        glDrawElements(GL_TRIANGLES, planeMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);    // Flips the the back buffer with the front buffer every frame.
         glfwPollEvents();
-    }
+        if (!USampleInput(window))
+            break;      // The replay ended
+        pacer.InputSampled();
+        UStepSimulation();
+        UApplySimulation();
 
-    // Release mesh data
-    UDestroyMesh(chestBodyMesh);
-    UDestroyMesh(chestDecorMesh);
-    UDestroyMesh(planeMesh);
+        // Swap in whatever textures finished decoding since the last frame
+        {
+            CpuZone zone(profiler, "TextureUpload");
+            GpuZone gpuZone(profiler, "TextureUpload");
+            textureLoader.Update();
+        }
 
-    glDeleteVertexArrays(1, &cylinderVAO);
-    glDeleteBuffers(1, &cylinderVBO);
+        UUpdateViewState(framebufferWidth, framebufferHeight);
+        URenderScene(viewState);
+        if (options.capturePrefix)
+        {
+            CpuZone zone(profiler, "Capture");
+            frameCapture.Capture(framebufferWidth, framebufferHeight);
+        }
 
-    // Release texture
-    UDestroyTexture(chestWoodTexture);
-    UDestroyTexture(chestMetalTexture);
-    UDestroyTexture(marbleTexture);
+        // glfw: swap buffers; IO events are polled at the start of the next frame, right before input is sampled
+        {
+            CpuZone zone(profiler, "SwapBuffers");
+            glfwSwapBuffers(window);    // Flips the the back buffer with the front buffer every frame.
+        }
+        pacer.Submitted();
+    }
 
-    // Release shader program
-    UDestroyShaderProgram(shaderProgramId);
+    pacer.Report(cout);
+    cout << "INFO: " << renderQueue.DrawDataStalls() << " frames waited for the GPU to release their draw data" << endl;
+    pacer.Destroy();
+    UStopSimulation();
+    UStopInput();
+    if (options.capturePrefix)
+    {
+        frameCapture.Finish();
+        frameCapture.Report(cout);
+    }
+    UFinishProfile(options);
+    UDestroyScene();
 
-    exit(EXIT_SUCCESS); // Terminates the program successfully
+    glfwTerminate();
+    return EXIT_SUCCESS;
 }
 
-// Implements the UCreateMesh function
-void UCreateChestBodyMesh(GLMesh& mesh)
+
+// Headless mode: renders the scene into an offscreen framebuffer and reports frame times
+int URunHeadless(const RunOptions& options)
 {
-    // Position and Color data
-    GLfloat chestBodyV[] = {
-        // Vertex Positions      // Colors (r,g,b,a)        // Texture Coords
-         0.5f,  0.25f, -0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    1.0f, 1.0f,    // Vertex 0 Back Top Right
-         0.5f, -0.25f, -0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    1.0f, 0.0f,    // Vertex 1 Back Bottom Right
-        -0.5f, -0.25f, -0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    0.5f, 0.0f,    // Vertex 2 Back Bottom Left
-        -0.5f,  0.25f, -0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    0.5f, 1.0f,    // Vertex 3 Back Top Left
-         0.5f,  0.25f,  0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    0.5f, 1.0f,    // Vertex 4 Front Top Right
-         0.5f, -0.25f,  0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    0.5f, 0.0f,    // Vertex 5 Front Bottom Right
-        -0.5f, -0.25f,  0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    0.0f, 0.0f,    // Vertex 6 Front Bottom Left
-        -0.5f,  0.25f,  0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    0.0f, 1.0f,    // Vertex 7 Front Top Left
-    };
+    headless::HeadlessContext context;
+    if (!context.Create(4, 4))
+        return EXIT_FAILURE;
 
-    // Index data to share position data
-    GLushort chestBodyI[] = {
-        0, 1, 2, 0, 2, 3, // Box Back       Triangles 1 and 2
-        0, 1, 5, 0, 4, 5, // Box Right Side Triangles 3 and 4
-        0, 3, 7, 0, 4, 7, // Box Top        Triangles 5 and 6
-        1, 2, 6, 1, 5, 6, // Box Bottom     Triangles 7 and 8
-        2, 3, 7, 2, 6, 7, // Box Left Side  Triangles 9 and 10
-        4, 5, 6, 4, 6, 7, // Box Front      Triangles 11 and 12
-    };
+    // Displays GPU OpenGL version
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+    cout << "INFO: OpenGL Renderer: " << glGetString(GL_RENDERER) << endl;
 
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerColor = 4;
-    const GLuint floatsPerTex = 2;
+    headless::OffscreenTarget target;
+    if (!target.Create(options.width, options.height))
+        return EXIT_FAILURE;
+    target.Bind();
 
-    glGenVertexArrays(1, &mesh.VAO); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.VAO);
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.VBO);
-    glGenBuffers(1, &mesh.EBO);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(chestBodyV), chestBodyV, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+    UStartProfile(options);
+    if (!UCreateScene(options.sceneFile))
+        return EXIT_FAILURE;
 
-    mesh.nIndices = sizeof(chestBodyI) / sizeof(chestBodyI[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(chestBodyI), chestBodyI, GL_STATIC_DRAW);
+    // Measure rendering, not loading
+    {
+        CpuZone zone(profiler, "FinishTextureLoads");
+        if (!UFinishTextureLoads())
+            return EXIT_FAILURE;
+    }
 
-    // Strides between vertex coordinates is 8 (x, y, z, r, g, b, a, tc1, tc2). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerTex);// The number of floats before each
+    if (options.goldenDirectory)
+    {
+        bool passed = URunGolden(options);
+        UFinishProfile(options);
+        UDestroyScene();
+        target.Destroy();
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (options.batchFile)
+    {
+        bool rendered = URunBatch(options);
+        UFinishProfile(options);
+        UDestroyScene();
+        target.Destroy();
+        return rendered ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+    UUpdateViewState(options.width, options.height);
 
-    glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+    // Warm-up frames let the driver finish lazy shader and texture work before measuring
+    for (int i = 0; i < options.warmupFrames; ++i)
+    {
+        profiler.BeginFrame();
+        URenderScene(viewState);
+    }
+    glFinish();
 
-    glVertexAttribPointer(2, floatsPerTex, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * (floatsPerVertex + floatsPerColor)));
-    glEnableVertexAttribArray(2);
+    // A replay moves the camera along its recorded path, one measured frame per recorded frame;
+    // otherwise the same view is drawn every frame
+    if (!UStartInput(options))
+        return EXIT_FAILURE;
+    bool replaying = inputReplay.Loaded();
+    int frames = replaying ? (int)inputReplay.FrameCount() : options.frames;
+    if (replaying)
+        UStartSimulation(options);
+    if (options.capturePrefix && !frameCapture.Create(options.capturePrefix, options.captureFormat))
+        return EXIT_FAILURE;
 
-}
+    {
+        FrameBenchmark benchmark;
+        for (int i = 0; i < frames; ++i)
+        {
+            profiler.BeginFrame();
+            CpuZone frameZone(profiler, "Frame");
+            benchmark.BeginFrame();
+            if (replaying)
+            {
+                USampleInput(nullptr);
+                UStepSimulation();
+                UApplySimulation();
+                UUpdateViewState(options.width, options.height);
+            }
+            URenderScene(viewState);
+            if (options.capturePrefix)
+            {
+                CpuZone zone(profiler, "Capture");
+                frameCapture.Capture(options.width, options.height);
+            }
+            benchmark.EndFrame();
+        }
+        glFinish();
+        benchmark.Finish();
 
-void UCreateChestDecorMesh(GLMesh& mesh)
-{
-    // Position and Color data
-    GLfloat chestDecorV[] = {
-        // Vertex Positions        // Colors (r,g,b,a)           // Texture coords 
-         0.51f,  0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    1.0f, 1.0f,    // Vertex 0 Back Top Right
-         0.51f, -0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    1.0f, 0.0f,    // Vertex 1 Back Bottom Right
-        -0.51f, -0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 0.0f,    // Vertex 2 Back Bottom Left
-        -0.51f,  0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 1.0f,    // Vertex 3 Back Top Left
-         0.51f,  0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 1.0f,    // Vertex 4 Front Top Right
-         0.51f, -0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 0.0f,    // Vertex 5 Front Bottom Right
-        -0.51f, -0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.0f, 0.0f,    // Vertex 6 Front Bottom Left
-        -0.51f,  0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.0f, 1.0f,    // Vertex 7 Front Top Left
-    };
+        cout << "INFO: Headless benchmark at " << options.width << "x" << options.height << endl;
+        benchmark.Report(cout);
+        cout << "INFO: " << renderQueue.DrawDataStalls() << " frames waited for the GPU to release their draw data" << endl;
+    }
 
-    // Index data to share position data
-    GLushort chestDecorI[] = {
-        0, 1, 2, 0, 2, 3, // Box Back       Triangles 1 and 2
-        0, 1, 5, 0, 4, 5, // Box Right Side Triangles 3 and 4
-        0, 3, 7, 0, 4, 7, // Box Top        Triangles 5 and 6
-        1, 2, 6, 1, 5, 6, // Box Bottom     Triangles 7 and 8
-        2, 3, 7, 2, 6, 7, // Box Left Side  Triangles 9 and 10
-        4, 5, 6, 4, 6, 7, // Box Front      Triangles 11 and 12
-    };
+    if (replaying)
+        UStopSimulation();
+    UStopInput();
+    if (options.capturePrefix)
+    {
+        frameCapture.Finish();
+        frameCapture.Report(cout);
+    }
+    UFinishProfile(options);
+    UDestroyScene();
+    target.Destroy();
 
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerColor = 4;
-    const GLuint floatsPerTex = 2;
+    return EXIT_SUCCESS;
+}
 
-    glGenVertexArrays(1, &mesh.VAO); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.VAO);
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.VBO);
-    glGenBuffers(1, &mesh.EBO);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(chestDecorV), chestDecorV, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    mesh.nIndices = sizeof(chestDecorI) / sizeof(chestDecorI[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(chestDecorI), chestDecorI, GL_STATIC_DRAW);
+// Golden mode: renders every golden view and checks its image, median frame time and draw calls against the references
+bool URunGolden(const RunOptions& options)
+{
+    // References are named after the scene file, so several scenes can share a directory
+    string prefix = options.sceneFile;
+    prefix = prefix.substr(prefix.find_last_of("/\\") + 1);
+    prefix = prefix.substr(0, prefix.find_last_of('.'));
+    GoldenSuite suite(options.goldenDirectory, prefix, options.goldenUpdate);
 
-    // Strides between vertex coordinates is 8 (x, y, z, r, g, b, a, tc1, tc2). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerTex);// The number of floats before each
+    for (const GoldenView& golden : GOLDEN_VIEWS)
+    {
+        UApplyPose(golden.pose);
+        UUpdateViewState(options.width, options.height);
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+        for (int i = 0; i < options.warmupFrames; ++i)
+        {
+            profiler.BeginFrame();
+            URenderScene(viewState);
+        }
+        glFinish();
 
-    glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+        // Every frame is finished before the next starts, so its time includes the GPU work
+        RenderStats stats;
+        vector<double> frameTimes;
+        for (int i = 0; i < options.frames; ++i)
+        {
+            profiler.BeginFrame();
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            stats = URenderScene(viewState);
+            glFinish();
+            frameTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        }
+        sort(frameTimes.begin(), frameTimes.end());
 
-    glVertexAttribPointer(2, floatsPerTex, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerColor)));
-    glEnableVertexAttribArray(2);
+        suite.Check(golden.name, ReadFramebuffer(options.width, options.height), FrameBenchmark::Percentile(frameTimes, 0.5), stats.drawCalls);
+    }
+    return suite.Report(cout);
 }
 
-void UCreatePlaneMesh(GLMesh& mesh)
-{
-    // Position and Color data
-    GLfloat planeV[] = {
-        // Vertex Positions   // Colors (r,g,b,a)      // Texture
-         0.5f, 0.0f, -0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  1.0f, 1.0f,  // Vertex 0 Back Right
-         0.5f, 0.0f,  0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  1.0f, 0.0f,  // Vertex 1 Front Right
-        -0.5f, 0.0f,  0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  0.0f, 0.0f,  // Vertex 2 Front Left
-        -0.5f, 0.0f, -0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  0.0f, 1.0f,  // Vertex 3 Back Left
-    };
-
-    // Index data to share position data
-    GLushort planeI[] = {
-        0, 1, 2, 0, 2, 3, // Plane Triangles 1 and 2
-    };
-
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerColor = 4;
-    const GLuint floatsPerTex = 2;
 
-    glGenVertexArrays(1, &mesh.VAO); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.VAO);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(1, &mesh.VBO);
-    glGenBuffers(1, &mesh.EBO);
+// Batch mode: renders an image per pose back to back and writes them out; the scene and textures are set up once.
+// Readbacks and writing overlap the rendering of the following poses (see FrameCapture), so throughput is images per second.
+bool URunBatch(const RunOptions& options)
+{
+    vector<CameraPose> poses;
+    if (!ULoadPoses(options.batchFile, poses))
+        return false;
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeV), planeV, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+    headless::OffscreenTarget targets[BATCH_TARGETS];
+    for (headless::OffscreenTarget& target : targets)
+    {
+        if (!target.Create(options.width, options.height))
+            return false;
+    }
 
-    mesh.nIndices = sizeof(planeI) / sizeof(planeI[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeI), planeI, GL_STATIC_DRAW);
+    // One unwritten image lets the driver finish lazy shader and texture work first
+    targets[0].Bind();
+    UApplyPose(poses[0]);
+    UUpdateViewState(options.width, options.height);
+    profiler.BeginFrame();
+    URenderScene(viewState);
+    glFinish();
 
-    // Strides between vertex coordinates is 8 (x, y, z, r, g, b, a, tc1, tc2). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerTex);// The number of floats before each
+    if (!frameCapture.Create(options.capturePrefix ? options.capturePrefix : "batch", options.captureFormat))
+        return false;
 
-    // Position attribute
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        const headless::OffscreenTarget& target = targets[i % BATCH_TARGETS];
+        target.Bind();
+        UApplyPose(poses[i]);
+        UUpdateViewState(target.width, target.height);
+        profiler.BeginFrame();
+        URenderScene(viewState);
+        frameCapture.Capture(target.width, target.height);
+    }
+    frameCapture.Finish();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-    // Color attribute
-    glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+    for (headless::OffscreenTarget& target : targets)
+        target.Destroy();
 
-    glVertexAttribPointer(2, floatsPerTex, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerColor)));
-    glEnableVertexAttribArray(2);
+    cout << "INFO: Batch rendered " << poses.size() << " images at " << options.width << "x" << options.height << " in " << seconds << " s, "
+         << poses.size() / seconds << " images per second" << endl;
+    frameCapture.Report(cout);
+    return true;
 }
 
-void UDestroyMesh(GLMesh& mesh)
+
+/*
+ * Reads camera poses, one per line:
+ *
+ *     x y z yaw pitch [ortho]
+ *
+ * position and Euler angles in degrees as Camera uses them, and "ortho" for an
+ * orthographic projection. Blank lines and lines starting with # are skipped.
+ */
+bool ULoadPoses(const char* filename, vector<CameraPose>& poses)
 {
-    glDeleteVertexArrays(1, &mesh.VAO);
-    glDeleteBuffers(1, &mesh.VBO);
-    glDeleteBuffers(1, &mesh.EBO);
+    ifstream file(filename);
+    if (!file)
+    {
+        cout << "Could not open pose file " << filename << endl;
+        return false;
+    }
+
+    string line;
+    for (int lineNumber = 1; getline(file, line); ++lineNumber)
+    {
+        istringstream fields(line);
+        string first;
+        if (!(fields >> first) || first[0] == '#')
+            continue;
+
+        CameraPose pose;
+        fields.clear();
+        fields.seekg(0);
+        string projection;
+        if (!(fields >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch))
+        {
+            cout << filename << ":" << lineNumber << ": expected x y z yaw pitch [ortho]" << endl;
+            return false;
+        }
+        pose.ortho = (fields >> projection) && projection == "ortho";
+        poses.push_back(pose);
+    }
+
+    if (poses.empty())
+    {
+        cout << "Pose file " << filename << " has no poses" << endl;
+        return false;
+    }
+    return true;
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void UProcessInput(GLFWwindow* window)
+// Places the camera and picks the projection; ortho goes first, since the camera's vectors depend on it
+void UApplyPose(const CameraPose& pose)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) // W: goes forward
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) // S: goes backward
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) // A: goes left
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) // D: goes right
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) // E: goes upward
-        camera.ProcessKeyboard(UPWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) // Q: goes downward
-        camera.ProcessKeyboard(DOWNWARD, deltaTime);
+    ortho = pose.ortho;
+    camera.SetPosition(pose.position);
+    camera.SetOrientation(pose.yaw, pose.pitch);
 }
 
-// Key callback to handle key "P" to change to Ortho
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+
+// Creates the meshes, shader program and textures used by the chest scene
+bool UCreateScene(const char* sceneFile)
 {
-    if (action == GLFW_RELEASE) return; //only handle press events
-    if (key == GLFW_KEY_P) 
-        ortho = !ortho;
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    // Create the shader program; the mesh layout depends on the attributes it reads
+    if (!shaderProgram.Build(vertexShaderSource, fragmentShaderSource, &programCache))
+        return false;
+
+    jobs.Create();
+
+    // Load the scene description, generate its primitives and map its models, then size the arena for all of them
+    SceneMeshSources sources;
+    if (!LoadScene(sceneFile, scene) || !UGeneratePrimitives(sources) || !UOpenModels(sources))
+        return false;
+    if (!UCreateMeshArena(sources.vertexCount, sources.indexCount))
+        return false;
+    if (!UCreateChestBodyMesh(chestBodyMesh) || !UCreateChestDecorMesh(chestDecorMesh) || !UCreatePlaneMesh(planeMesh))
+        return false;
+    if (!UAddPrimitiveMeshes(sources) || !UAddModels(sources))
+        return false;
+
+    cameraBuffer.Create();
+
+    // Meshes read their model matrix and flags from the queue's per-draw storage buffer
+    if (!renderQueue.Create())
+        return false;
+    renderQueue.AttachInstanceAttributes(meshRegistry.Vao());
+
+    // Load the textures the scene declares
+
+    textureLoader.Create();
+    sceneTextures.assign(scene.textures.size(), 0);
+    for (size_t i = 0; i < scene.textures.size(); ++i)
+        sceneTextures[i] = textureLoader.Request(scene.textures[i].filename);
+
+    // Resolve each object's mesh and textures once; only the sort key changes per frame
+    sceneDraws.clear();
+    sceneLods.clear();
+    sceneBounds.clear();
+    spinningObjects.clear();
+    for (const SceneObject& object : scene.objects)
+    {
+        DrawItem item;
+        Bounds bounds;
+        int primitive = -1;
+        if (!UFindSceneMesh(object.mesh, item, bounds, primitive))
+        {
+            cout << "Object " << object.name << " uses unknown mesh " << object.mesh << endl;
+            return false;
+        }
+        item.program = shaderProgram.id;
+        item.textures[0] = sceneTextures[scene.FindTexture(object.textures[0])];
+        if (object.HasExtraTexture())
+            item.textures[1] = sceneTextures[scene.FindTexture(object.textures[1])];
+        item.flags = object.HasExtraTexture();
+        item.model = object.model;
+        sceneDraws.push_back(item);
+        sceneLods.push_back(primitive);
+        sceneBounds.push_back(bounds.Transform(object.model));
+        if (object.Spins())
+            spinningObjects.push_back(SpinningObject{ (uint32_t)sceneDraws.size() - 1, bounds });
+    }
+
+    UCreatePartitions();
+
+    // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
+    shaderProgram.Use();
+
+    glUniform1i(shaderProgram.Uniform("uTextureBase"), 0);
+    glUniform1i(shaderProgram.Uniform("uTextureExtra"), 1);
+
+    return true;
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-// ---------------------------------------------------------------------------------------------
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+
+// Blocks until every scene texture is uploaded; false when any of them failed to load
+bool UFinishTextureLoads()
 {
-    // make sure the viewport matches the new window dimensions; note that width and 
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    return textureLoader.Finish();
 }
 
 
-// glfw: whenever the mouse moves, this callback is called
-// -------------------------------------------------------
-void mouse_callback(GLFWwindow* window, double xpos, double ypos)
+// Starts recording zones when a profile file was requested
+void UStartProfile(const RunOptions& options)
 {
-    if (firstMouse)
-    {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
+    if (options.profileFile)
+        profiler.Create();
+}
+
+
+// Writes the recorded zones to the requested profile file and stops recording
+void UFinishProfile(const RunOptions& options)
+{
+    if (!profiler.Enabled())
+        return;
+
+    profiler.Finish();
+    if (profiler.WriteChromeTrace(options.profileFile))
+        cout << "INFO: Profile written to " << options.profileFile << endl;
+    profiler.Destroy();
+}
+
+
+// Releases everything created by UCreateScene
+void UDestroyScene()
+{
+    // Release mesh data
+    meshRegistry.Destroy();
+    primitiveMeshes.clear();
+
+    // Release texture
+    textureLoader.Destroy();
+    for (GLuint texture : sceneTextures)
+        UDestroyTexture(texture);
+    sceneTextures.clear();
+    sceneDraws.clear();
+    sceneLods.clear();
+    sceneBounds.clear();
+    spinningObjects.clear();
+    scenePartitions.clear();
+    jobs.Destroy();
+
+    // Release shader program
+    shaderProgram.Destroy();
+    cameraBuffer.Destroy();
+    renderQueue.Destroy();
+}
+
+
+// Creates the perspective or orthographic projection for the given framebuffer size
+glm::mat4 UGetProjection(bool isOrtho, int width, int height)
+{
+    glm::mat4 projection;
+    // Creates a perspective projection
+    // Condition if orthographic
+    if (isOrtho) {
+        float scale = 200;
+        float scaledWidth = (GLfloat)width / scale;
+        float scaledHeight = (GLfloat)height / scale;
+        projection = glm::ortho(-scaledWidth, scaledWidth, scaledHeight, -scaledHeight, -4.0f, 10.0f);
+    }
+    else {
+        projection = glm::perspective(45.0f, (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
     }
+    return projection;
+}
 
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
 
-    lastX = xpos;
-    lastY = ypos;
+// Brings the view state up to date with the camera, ortho mode and framebuffer size
+void UUpdateViewState(int width, int height)
+{
+    // A minimized window has no size; keep the last projection
+    if (width <= 0 || height <= 0)
+        return;
 
-    // Mouse cursor changes orientation of the camera
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    const glm::mat4& view = camera.GetViewMatrix(ortho);
+    viewState.Update(camera.GetVersion(), view, ortho, width, height, UGetProjection);
 }
 
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+
+// Draws one frame of the chest scene into the currently bound framebuffer
+RenderStats URenderScene(const ViewState& viewState)
 {
-    /*
-     * Mouse Scroll changes speed
-     * Scrolling up increases speed
-     * Scrolling down decreases speed
-     */
-    camera.ProcessMouseScroll(yoffset);
+    const glm::mat4& view = viewState.View();
+
+    CpuZone zone(profiler, "RenderScene");
+    GpuZone gpuZone(profiler, "RenderScene");
+
+    // Clear the frame and z buffers
+    {
+        GpuZone clearZone(profiler, "Clear");
+        glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // camera/view transformation, uploaded once for every program and only when it changed
+    cameraBuffer.Update(view, viewState.Projection(), viewState.Version());
+
+    shaderProgram.Use();
+
+    // Cull and record every partition on the workers, then merge their sorted draws here
+    {
+        CpuZone queueZone(profiler, "BuildQueue");
+        jobs.ParallelFor((unsigned)scenePartitions.size(), 1, [&viewState](unsigned first, unsigned last)
+        {
+            for (unsigned i = first; i < last; ++i)
+                URecordPartition(scenePartitions[i], viewState);
+        });
+
+        renderQueue.Clear();
+        for (const ScenePartition& partition : scenePartitions)
+            renderQueue.Append(partition.commands);
+    }
+
+    CpuZone submitZone(profiler, "Submit");
+    GpuZone gpuSubmitZone(profiler, "Submit");
+    return renderQueue.Submit();
 }
 
-/*Generate and load the texture*/
-bool UCreateTexture(const char* filename, GLuint& textureId)
+
+// Splits the scene's draws into one partition per job thread, or fewer when the scene is small
+void UCreatePartitions()
 {
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
+    size_t objects = sceneBounds.size();
+    size_t count = (objects + MIN_PARTITION_OBJECTS - 1) / MIN_PARTITION_OBJECTS;
+    count = max<size_t>(1, min<size_t>(count, jobs.ThreadCount()));
+
+    scenePartitions.clear();
+    scenePartitions.resize(count);
+    for (size_t i = 0; i < count; ++i)
     {
-        flipImageVertically(image, width, height, channels);
+        ScenePartition& partition = scenePartitions[i];
+        partition.first = (uint32_t)(objects * i / count);
+        partition.count = (uint32_t)(objects * (i + 1) / count) - partition.first;
+        if (objects >= BVH_MIN_OBJECTS)
+        {
+            vector<Bounds>::const_iterator first = sceneBounds.begin() + partition.first;
+            partition.hierarchy.Build(vector<Bounds>(first, first + partition.count));
+        }
+    }
+}
 
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
 
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Culls one partition and records its visible draws, sorted; runs on any thread and makes no GL calls
+void URecordPartition(ScenePartition& partition, const ViewState& view)
+{
+    CpuZone zone(profiler, "RecordPartition");
 
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        else
+    // Keep only the objects that intersect the view frustum
+    const Frustum& frustum = view.GetFrustum();
+    partition.visible.clear();
+    if (partition.hierarchy.Size() > 0)
+    {
+        partition.hierarchy.Query(frustum, partition.visible);
+        for (uint32_t& index : partition.visible)
+            index += partition.first;
+    }
+    else
+    {
+        for (uint32_t i = partition.first; i < partition.first + partition.count; ++i)
+            if (frustum.Visible(sceneBounds[i]))
+                partition.visible.push_back(i);
+    }
+
+    partition.commands.Clear();
+    for (uint32_t index : partition.visible)
+    {
+        DrawItem item = sceneDraws[index];
+
+        // Generated primitives draw the level that matches their size on screen
+        if (sceneLods[index] >= 0)
         {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
+            const PrimitiveMesh& primitive = primitiveMeshes[sceneLods[index]];
+            UUseMesh(primitive.levels[USelectLod(primitive, sceneBounds[index], view)], item);
         }
 
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // Distance in front of the camera (view space looks down -Z)
+        float viewDepth = -(view.View() * item.model[3]).z;
+        partition.commands.Push(item, viewDepth, 100.0f);
+    }
+    partition.commands.Sort();
+}
 
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+// Creates the shared arena with room for the scene's meshes and the hand-written ones;
+// its vertex layout is SceneVertex minus what the shader ignores
+bool UCreateMeshArena(size_t sceneVertices, size_t sceneIndices)
+{
+    meshLayout = SceneVertex::Layout::Strip(shaderProgram.ActiveAttributeMask());
 
-        return true;
+    size_t maxVertices = BUILT_IN_MESH_VERTICES + sceneVertices;
+    size_t maxIndices = BUILT_IN_MESH_INDICES + sceneIndices;
+    if (maxVertices > INT32_MAX || maxIndices > UINT32_MAX)
+    {
+        cout << "The scene's meshes do not fit one arena (" << maxVertices << " vertices, " << maxIndices << " indices)" << endl;
+        return false;
     }
+    if (!meshRegistry.Create(meshLayout.stride, (GLuint)maxVertices, (GLuint)maxIndices))
+    {
+        cout << "Failed to create the mesh arena" << endl;
+        return false;
+    }
+
+    // Create Vertex Attribute Pointers (the arena's VAO and vertex buffer are still bound)
+    meshLayout.Apply();
 
-    // Error loading the image
-    return false;
+    glBindVertexArray(0);
+    return true;
 }
 
+// Packs 9-float vertices (x, y, z, r, g, b, a, tc1, tc2) into the arena's layout and adds the mesh
+bool UAddInterleavedMesh(const GLfloat* vertices, GLuint vertexCount, const GLushort* indices, GLuint indexCount, GLMesh& mesh)
+{
+    vector<SourceVertex> source(vertexCount);
+    for (GLuint i = 0; i < vertexCount; ++i)
+    {
+        const GLfloat* v = vertices + 9 * i;
+        source[i].position = glm::vec3(v[0], v[1], v[2]);
+        source[i].color = glm::vec4(v[3], v[4], v[5], v[6]);
+        source[i].texCoord = glm::vec2(v[7], v[8]);
+    }
 
-void UDestroyTexture(GLuint textureId)
+    return UAddSourceMesh(source, vector<GLushort>(indices, indices + indexCount), mesh);
+}
+
+// Packs vertices into the arena's layout, adds the mesh and records its bounds
+bool UAddSourceMesh(const vector<SourceVertex>& vertices, const vector<GLushort>& indices, GLMesh& mesh)
 {
-    glGenTextures(1, &textureId);
+    vector<unsigned char> packed;
+    UPackSourceMesh(vertices, packed, mesh);
+    return meshRegistry.Add(packed.data(), (GLuint)vertices.size(), indices.data(), (GLuint)indices.size(), mesh);
 }
 
+// Same for a mesh with 32-bit indices
+bool UAddSourceMesh(const vector<SourceVertex>& vertices, const vector<uint32_t>& indices, GLMesh& mesh)
+{
+    vector<unsigned char> packed;
+    UPackSourceMesh(vertices, packed, mesh);
+    return meshRegistry.Add(packed.data(), (GLuint)vertices.size(), (const GLuint*)indices.data(), (GLuint)indices.size(), mesh);
+}
 
-// Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+// Packs vertices into the arena's layout and records their bounds as the mesh's
+void UPackSourceMesh(const vector<SourceVertex>& vertices, vector<unsigned char>& packed, GLMesh& mesh)
 {
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
+    Bounds bounds;
+    for (const SourceVertex& vertex : vertices)
+        bounds.Add(vertex.position);
+    mesh.bounds = bounds;
+    meshLayout.Pack(vertices.data(), vertices.size(), packed);
+}
 
-    // Create a Shader program object.
-    programId = glCreateProgram();
+// Arena index space a mesh takes: GLushort indices up to 65536 vertices, GLuint ones (two slots each, plus alignment) above
+size_t UIndexSlots(size_t vertexCount, size_t indexCount)
+{
+    return vertexCount <= 65536 ? indexCount : 2 * indexCount + 1;
+}
 
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+// Generates every level of every primitive the scene declares, as jobs; only the uploads need the GL thread
+bool UGeneratePrimitives(SceneMeshSources& sources)
+{
+    vector<pair<const ScenePrimitive*, const SceneLod*>> levels;
+    for (const ScenePrimitive& declaration : scene.primitives)
+        for (const SceneLod& lod : declaration.lods)
+            levels.push_back(make_pair(&declaration, &lod));
+
+    sources.primitiveLevels.assign(levels.size(), MeshData());
+    vector<char> valid(levels.size());
+    jobs.ParallelFor((unsigned)levels.size(), 1, [&](unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i < last; ++i)
+            valid[i] = GeneratePrimitive(levels[i].first->type, levels[i].first->size, levels[i].second->segments, sources.primitiveLevels[i]);
+    });
 
-    // Retrive the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        if (!valid[i])
+        {
+            cout << "Primitive " << levels[i].first->name << " has unknown type " << levels[i].first->type << endl;
+            return false;
+        }
+        sources.vertexCount += sources.primitiveLevels[i].vertices.size();
+        sources.indexCount += UIndexSlots(sources.primitiveLevels[i].vertices.size(), sources.primitiveLevels[i].indices.size());
+    }
+    return true;
+}
 
-    // Compile the vertex shader, and print compilation errors (if any)
-    glCompileShader(vertexShaderId); // compile the vertex shader
-    // check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
+// Maps every model's mesh file, or imports it when it is an OBJ file
+bool UOpenModels(SceneMeshSources& sources)
+{
+    for (const SceneModel& declaration : scene.models)
     {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        const string& filename = declaration.filename;
+        sources.modelFiles.push_back(nullptr);
+        sources.importedModels.push_back(ImportedMesh());
+        if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".obj") == 0)
+        {
+            ImportedMesh& imported = sources.importedModels.back();
+            if (!ImportObj(filename.c_str(), jobs, imported))
+                return false;
+            sources.vertexCount += imported.vertices.size();
+            sources.indexCount += UIndexSlots(imported.vertices.size(), imported.indices.size());
+            continue;
+        }
 
-        return false;
+        unique_ptr<MeshFile> file(new MeshFile());
+        if (!file->Open(filename.c_str()))
+            return false;
+        size_t slotsPerIndex = file->IndexType() == GL_UNSIGNED_INT ? 2 : 1;
+        for (uint32_t i = 0; i < file->LodCount(); ++i)
+        {
+            sources.vertexCount += file->Lod(i).vertexCount;
+            sources.indexCount += file->Lod(i).indexCount * slotsPerIndex + slotsPerIndex - 1;
+        }
+        sources.modelFiles.back() = move(file);
+    }
+    return true;
+}
+
+// Adds every generated primitive level to the arena
+bool UAddPrimitiveMeshes(const SceneMeshSources& sources)
+{
+    primitiveMeshes.clear();
+    size_t next = 0;
+    for (const ScenePrimitive& declaration : scene.primitives)
+    {
+        PrimitiveMesh primitive;
+        primitive.name = declaration.name;
+        for (const SceneLod& lod : declaration.lods)
+        {
+            const MeshData& data = sources.primitiveLevels[next++];
+            GLMesh level;
+            if (!UAddSourceMesh(data.vertices, data.indices, level))
+                return false;
+            primitive.levels.push_back(level);
+            primitive.minScreenSizes.push_back(lod.minScreenSize);
+            primitive.bounds.Add(level.bounds);
+        }
+        primitiveMeshes.push_back(primitive);
+    }
+    return true;
+}
+
+// Adds every model's levels to the arena, where objects find them like a generated primitive
+bool UAddModels(const SceneMeshSources& sources)
+{
+    for (size_t m = 0; m < scene.models.size(); ++m)
+    {
+        const SceneModel& declaration = scene.models[m];
+        PrimitiveMesh model;
+        model.name = declaration.name;
+
+        const MeshFile* file = sources.modelFiles[m].get();
+        if (!file)
+        {
+            // Imported as a single level, with 16-bit indices when it is small enough
+            const ImportedMesh& imported = sources.importedModels[m];
+            MeshData narrow;
+            GLMesh level;
+            bool added = ToMeshData(imported, narrow) ? UAddSourceMesh(narrow.vertices, narrow.indices, level)
+                : UAddSourceMesh(imported.vertices, imported.indices, level);
+            if (!added)
+                return false;
+            model.levels.push_back(level);
+            model.minScreenSizes.push_back(0.0f);
+            model.bounds = level.bounds;
+            primitiveMeshes.push_back(model);
+            cout << "INFO: Model " << declaration.name << ": imported " << declaration.filename << ", " << imported.vertices.size() << " vertices, "
+                 << imported.indices.size() / 3 << " triangles" << endl;
+            continue;
+        }
+
+        // Files written in the arena's layout upload straight from the mapping; others are repacked first
+        PackedLayout layout = file->Layout();
+        bool direct = layout.stride == meshLayout.stride && layout.attributes.size() == meshLayout.attributes.size();
+        for (size_t i = 0; direct && i < layout.attributes.size(); ++i)
+            direct = layout.attributes[i].location == meshLayout.attributes[i].location && layout.attributes[i].format == meshLayout.attributes[i].format
+                && layout.attributes[i].offset == meshLayout.attributes[i].offset;
+
+        vector<unsigned char> packed;
+        for (uint32_t i = 0; i < file->LodCount(); ++i)
+        {
+            const MeshFileLod& lod = file->Lod(i);
+            const void* vertices = file->Vertices(i);
+            if (!direct)
+            {
+                if (!URepackVertices(layout, vertices, lod.vertexCount, packed))
+                {
+                    cout << "Model " << declaration.name << " lacks attributes the shader reads" << endl;
+                    return false;
+                }
+                vertices = packed.data();
+            }
+
+            // Levels of a file are distinct meshes, so they skip the registry's hashing and CPU copy
+            GLMesh level;
+            bool added = file->IndexType() == GL_UNSIGNED_INT
+                ? meshRegistry.Add(vertices, lod.vertexCount, (const GLuint*)file->Indices(i), lod.indexCount, level, false)
+                : meshRegistry.Add(vertices, lod.vertexCount, (const GLushort*)file->Indices(i), lod.indexCount, level, false);
+            if (!added)
+                return false;
+            level.bounds = file->LodBounds(i);
+            model.levels.push_back(level);
+            model.minScreenSizes.push_back(lod.minScreenSize);
+            model.bounds.Add(level.bounds);
+        }
+        primitiveMeshes.push_back(model);
+
+        cout << "INFO: Model " << declaration.name << ": " << file->LodCount() << " levels from " << declaration.filename
+             << (direct ? "" : " (repacked, written in another vertex layout)") << endl;
+    }
+    return true;
+}
+
+// Copies the attributes of the arena's layout out of vertices in another one; false when one is missing
+bool URepackVertices(const PackedLayout& layout, const void* vertices, GLuint vertexCount, vector<unsigned char>& packed)
+{
+    packed.assign((size_t)vertexCount * meshLayout.stride, 0);
+    for (const AttribDesc& target : meshLayout.attributes)
+    {
+        const AttribDesc* source = nullptr;
+        for (const AttribDesc& attribute : layout.attributes)
+            if (attribute.location == target.location && attribute.format == target.format)
+                source = &attribute;
+        if (!source)
+            return false;
+
+        const unsigned char* from = (const unsigned char*)vertices + source->offset;
+        unsigned char* to = packed.data() + target.offset;
+        for (GLuint v = 0; v < vertexCount; ++v)
+            memcpy(to + (size_t)v * meshLayout.stride, from + (size_t)v * layout.stride, AttribFormatSize(target.format));
     }
+    return true;
+}
 
-    glCompileShader(fragmentShaderId); // compile the fragment shader
-    // check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
+// Most detailed level whose threshold the object's projected height reaches; the last level otherwise
+size_t USelectLod(const PrimitiveMesh& primitive, const Bounds& bounds, const ViewState& view)
+{
+    // Height of the bounding sphere in normalized device coordinates (2 = the whole viewport), halved;
+    // clip w is the view depth in perspective and 1 in ortho
+    float clipW = (view.ViewProjection() * glm::vec4(bounds.center, 1.0f)).w;
+    float screenSize = bounds.radius * fabs(view.Projection()[1][1]) / max(clipW, 1e-4f);
+
+    for (size_t level = 0; level + 1 < primitive.levels.size(); ++level)
+        if (screenSize >= primitive.minScreenSizes[level])
+            return level;
+    return primitive.levels.size() - 1;
+}
+
+// Points a draw at a mesh's range of the shared arena
+void UUseMesh(const GLMesh& mesh, DrawItem& item)
+{
+    item.vao = meshRegistry.Vao();
+    item.baseVertex = mesh.baseVertex;
+    item.firstIndex = mesh.firstIndex;
+    item.indexCount = mesh.nIndices;
+    item.indexType = mesh.indexType;
+}
+
+// Maps a mesh name used in scene files to its GL geometry and model-space bounds;
+// primitive is set for generated meshes, whose level is picked every frame
+bool UFindSceneMesh(const string& name, DrawItem& item, Bounds& bounds, int& primitive)
+{
+    for (size_t i = 0; i < primitiveMeshes.size(); ++i)
     {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        if (primitiveMeshes[i].name == name)
+        {
+            UUseMesh(primitiveMeshes[i].levels[0], item);
+            bounds = primitiveMeshes[i].bounds;
+            primitive = (int)i;
+            return true;
+        }
+    }
 
+    const GLMesh* mesh = nullptr;
+    if (name == "chestBody")
+        mesh = &chestBodyMesh;
+    else if (name == "chestDecor")
+        mesh = &chestDecorMesh;
+    else if (name == "plane")
+        mesh = &planeMesh;
+    else
         return false;
+
+    UUseMesh(*mesh, item);
+    bounds = mesh->bounds;
+    return true;
+}
+
+
+// Implements the UCreateMesh function
+bool UCreateChestBodyMesh(GLMesh& mesh)
+{
+    // Position and Color data
+    GLfloat chestBodyV[] = {
+        // Vertex Positions      // Colors (r,g,b,a)        // Texture Coords
+         0.5f,  0.25f, -0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    1.0f, 1.0f,    // Vertex 0 Back Top Right
+         0.5f, -0.25f, -0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    1.0f, 0.0f,    // Vertex 1 Back Bottom Right
+        -0.5f, -0.25f, -0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    0.5f, 0.0f,    // Vertex 2 Back Bottom Left
+        -0.5f,  0.25f, -0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    0.5f, 1.0f,    // Vertex 3 Back Top Left
+         0.5f,  0.25f,  0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    0.5f, 1.0f,    // Vertex 4 Front Top Right
+         0.5f, -0.25f,  0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    0.5f, 0.0f,    // Vertex 5 Front Bottom Right
+        -0.5f, -0.25f,  0.25f,   0.7f, 0.4f, 0.0f, 1.0f,    0.0f, 0.0f,    // Vertex 6 Front Bottom Left
+        -0.5f,  0.25f,  0.25f,   0.9f, 0.6f, 0.2f, 1.0f,    0.0f, 1.0f,    // Vertex 7 Front Top Left
+    };
+
+    // Index data to share position data
+    GLushort chestBodyI[] = {
+        0, 1, 2, 0, 2, 3, // Box Back       Triangles 1 and 2
+        0, 1, 5, 0, 4, 5, // Box Right Side Triangles 3 and 4
+        0, 3, 7, 0, 4, 7, // Box Top        Triangles 5 and 6
+        1, 2, 6, 1, 5, 6, // Box Bottom     Triangles 7 and 8
+        2, 3, 7, 2, 6, 7, // Box Left Side  Triangles 9 and 10
+        4, 5, 6, 4, 6, 7, // Box Front      Triangles 11 and 12
+    };
+
+    // 9 floats per vertex: x, y, z, r, g, b, a, tc1, tc2
+    const GLuint floatsPerVertex = 9;
+    return UAddInterleavedMesh(chestBodyV, sizeof(chestBodyV) / (sizeof(GLfloat) * floatsPerVertex), chestBodyI, sizeof(chestBodyI) / sizeof(chestBodyI[0]), mesh);
+}
+
+bool UCreateChestDecorMesh(GLMesh& mesh)
+{
+    // Position and Color data
+    GLfloat chestDecorV[] = {
+        // Vertex Positions        // Colors (r,g,b,a)           // Texture coords 
+         0.51f,  0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    1.0f, 1.0f,    // Vertex 0 Back Top Right
+         0.51f, -0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    1.0f, 0.0f,    // Vertex 1 Back Bottom Right
+        -0.51f, -0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 0.0f,    // Vertex 2 Back Bottom Left
+        -0.51f,  0.05f, -0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 1.0f,    // Vertex 3 Back Top Left
+         0.51f,  0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 1.0f,    // Vertex 4 Front Top Right
+         0.51f, -0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.5f, 0.0f,    // Vertex 5 Front Bottom Right
+        -0.51f, -0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.0f, 0.0f,    // Vertex 6 Front Bottom Left
+        -0.51f,  0.05f,  0.251f,   0.35f, 0.30f, 0.28f, 1.0f,    0.0f, 1.0f,    // Vertex 7 Front Top Left
+    };
+
+    // Index data to share position data
+    GLushort chestDecorI[] = {
+        0, 1, 2, 0, 2, 3, // Box Back       Triangles 1 and 2
+        0, 1, 5, 0, 4, 5, // Box Right Side Triangles 3 and 4
+        0, 3, 7, 0, 4, 7, // Box Top        Triangles 5 and 6
+        1, 2, 6, 1, 5, 6, // Box Bottom     Triangles 7 and 8
+        2, 3, 7, 2, 6, 7, // Box Left Side  Triangles 9 and 10
+        4, 5, 6, 4, 6, 7, // Box Front      Triangles 11 and 12
+    };
+
+    // 9 floats per vertex: x, y, z, r, g, b, a, tc1, tc2
+    const GLuint floatsPerVertex = 9;
+    return UAddInterleavedMesh(chestDecorV, sizeof(chestDecorV) / (sizeof(GLfloat) * floatsPerVertex), chestDecorI, sizeof(chestDecorI) / sizeof(chestDecorI[0]), mesh);
+}
+
+bool UCreatePlaneMesh(GLMesh& mesh)
+{
+    // Position and Color data
+    GLfloat planeV[] = {
+        // Vertex Positions   // Colors (r,g,b,a)      // Texture
+         0.5f, 0.0f, -0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  1.0f, 1.0f,  // Vertex 0 Back Right
+         0.5f, 0.0f,  0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  1.0f, 0.0f,  // Vertex 1 Front Right
+        -0.5f, 0.0f,  0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  0.0f, 0.0f,  // Vertex 2 Front Left
+        -0.5f, 0.0f, -0.5f,   1.0f, 1.0f, 1.0f, 1.0f,  0.0f, 1.0f,  // Vertex 3 Back Left
+    };
+
+    // Index data to share position data
+    GLushort planeI[] = {
+        0, 1, 2, 0, 2, 3, // Plane Triangles 1 and 2
+    };
+
+    // 9 floats per vertex: x, y, z, r, g, b, a, tc1, tc2
+    const GLuint floatsPerVertex = 9;
+    return UAddInterleavedMesh(planeV, sizeof(planeV) / (sizeof(GLfloat) * floatsPerVertex), planeI, sizeof(planeI) / sizeof(planeI[0]), mesh);
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly.
+// Movement is handed to the simulation as a velocity; the camera only turns here (see mouse_callback).
+// Returns the movement keys held, one bit per Camera_Movement.
+unsigned UProcessInput(GLFWwindow* window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    unsigned heldKeys = 0;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) // W: goes forward
+        heldKeys |= 1u << FORWARD;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) // S: goes backward
+        heldKeys |= 1u << BACKWARD;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) // A: goes left
+        heldKeys |= 1u << LEFT;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) // D: goes right
+        heldKeys |= 1u << RIGHT;
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) // E: goes upward
+        heldKeys |= 1u << UPWARD;
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) // Q: goes downward
+        heldKeys |= 1u << DOWNWARD;
+
+    UApplyHeldKeys(heldKeys);
+    return heldKeys;
+}
+
+// Hands the simulation the velocity of the movement keys held
+void UApplyHeldKeys(unsigned heldKeys)
+{
+    glm::vec3 direction(0.0f);
+    for (int movement = FORWARD; movement <= DOWNWARD; ++movement)
+    {
+        if (heldKeys & (1u << movement))
+            direction += camera.MovementDirection((Camera_Movement)movement);
     }
 
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
+    simulationInputs.Back().velocity = direction * camera.MovementSpeed;
+    simulationInputs.Publish();
+}
+
+// Handles an event from the window; while a recording plays back, live input is ignored
+void UHandleInput(const InputEvent& event)
+{
+    if (inputReplay.Loaded())
+        return;
+    inputRecorder.Add(event);
+    UApplyInput(event);
+}
 
-    glLinkProgram(programId);   // links the shader program
-    // check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success)
+void UApplyInput(const InputEvent& event)
+{
+    switch (event.type)
     {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    case InputEventType::MouseMove:
+        // Mouse cursor changes orientation of the camera
+        camera.ProcessMouseMovement(event.x, event.y);
+        break;
+    case InputEventType::Scroll:
+        camera.ProcessMouseScroll(event.y);
+        break;
+    case InputEventType::KeyPress:
+        if (event.key == GLFW_KEY_P)
+            ortho = !ortho;
+        break;
+    }
+}
 
+// Opens the recording to write or to play back, if any was asked for
+bool UStartInput(const RunOptions& options)
+{
+    replayFrame = 0;
+    if (options.replayFile)
+    {
+        if (!inputReplay.Load(options.replayFile))
+            return false;
+        cout << "INFO: Replaying " << inputReplay.FrameCount() << " frames of input from " << options.replayFile << endl;
+    }
+    if (options.recordFile && !inputRecorder.Create(options.recordFile, options.tickRate))
         return false;
+    return true;
+}
+
+void UStopInput()
+{
+    if (inputRecorder.Recording())
+    {
+        cout << "INFO: Recorded " << inputRecorder.FrameCount() << " frames of input" << endl;
+        inputRecorder.Finish();
     }
+}
 
-    glUseProgram(programId);    // Uses the shader program
+// Samples this frame's input, live or from the replay, and advances the frame clock; false once the replay ran out.
+// A frame's events are applied before its held keys, both live and on playback, so movement follows the same turns.
+bool USampleInput(GLFWwindow* window)
+{
+    if (inputReplay.Loaded())
+    {
+        if (replayFrame == inputReplay.FrameCount() || (window && glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS))
+            return false;
 
+        const InputFrame& frame = inputReplay.Frame(replayFrame++);
+        for (const InputEvent& event : frame.events)
+            UApplyInput(event);
+        UApplyHeldKeys(frame.heldKeys);
+        frameClock += frame.delta;
+        return true;
+    }
+
+    unsigned heldKeys = window ? UProcessInput(window) : 0;
+    double now = SimulationNow();
+    double delta = now - lastClockSample;
+    lastClockSample = now;
+    frameClock += delta;
+    inputRecorder.EndFrame(delta, (uint8_t)heldKeys);
     return true;
 }
 
+// Starts ticking from the scene's initial state, on its own thread if requested
+void UStartSimulation(const RunOptions& options)
+{
+    simulation = SimulationState();
+    simulation.current.cameraPosition = camera.Position;
+    simulation.current.spinAngles.assign(spinningObjects.size(), 0.0f);
+    simulation.previous = simulation.current;
+
+    // A replay ticks at the rate it was recorded with
+    frameClock = 0.0;
+    lastClockSample = SimulationNow();
+    simulationTimestep = FixedTimestep(inputReplay.Loaded() ? inputReplay.TickRate() : options.tickRate);
+    simulationTimestep.Reset(options.simulationThread ? SimulationNow() : frameClock);
+    if (options.simulationThread)
+        simulationThread.Start(simulationTimestep, USimulationTick);
+}
+
+void UStopSimulation()
+{
+    simulationThread.Stop();
+    if (simulationTimestep.Dropped() > 0)
+        cout << "Simulation dropped " << simulationTimestep.Dropped() << " ticks it could not keep up with" << endl;
+}
+
+// The clock ticks are scheduled on: SimulationNow() on the simulation thread, the frame clock between frames
+double USimulationClock()
+{
+    return simulationThread.Running() ? SimulationNow() : frameClock;
+}
+
+// Runs the ticks due by now, unless the simulation thread does
+void UStepSimulation()
+{
+    if (simulationThread.Running())
+        return;
+
+    CpuZone zone(profiler, "Simulate");
+    double tickTime;
+    while (simulationTimestep.NextTick(frameClock, tickTime))
+        USimulationTick(tickTime);
+}
+
+// Advances the simulation by one fixed step and publishes the result
+void USimulationTick(double tickTime)
+{
+    float step = (float)simulationTimestep.Step();
+    simulationInputs.Update();
+    const SimulationInput& input = simulationInputs.Front();
+
+    simulation.previous = simulation.current;
+    simulation.current.cameraPosition += input.velocity * step;
+    for (size_t i = 0; i < spinningObjects.size(); ++i)
+    {
+        float& angle = simulation.current.spinAngles[i];
+        angle += scene.objects[spinningObjects[i].draw].spin.x * step;
+
+        // Wrap both frames together so blending them never crosses the seam
+        float turns = floor(angle / 360.0f);
+        angle -= turns * 360.0f;
+        simulation.previous.spinAngles[i] -= turns * 360.0f;
+    }
+    simulation.time = tickTime;
+
+    simulationStates.Back() = simulation;
+    simulationStates.Publish();
+}
+
+// Places the camera and spinning objects between the last two ticks, by how far now is past the latest
+void UApplySimulation()
+{
+    simulationStates.Update();
+    const SimulationState& state = simulationStates.Front();
+    if (state.time < 0.0)
+        return;
+
+    float alpha = (float)glm::clamp((USimulationClock() - state.time) / simulationTimestep.Step(), 0.0, 1.0);
+    camera.SetPosition(glm::mix(state.previous.cameraPosition, state.current.cameraPosition, alpha));
+    for (size_t i = 0; i < spinningObjects.size(); ++i)
+    {
+        const SpinningObject& spinning = spinningObjects[i];
+        float angle = glm::mix(state.previous.spinAngles[i], state.current.spinAngles[i], alpha);
+        UMoveDraw(spinning.draw, scene.objects[spinning.draw].ModelMatrix(angle), spinning.meshBounds);
+    }
+}
 
-void UDestroyShaderProgram(GLuint programId)
+// Gives a draw a new model matrix and refits its partition's hierarchy
+void UMoveDraw(uint32_t index, const glm::mat4& model, const Bounds& meshBounds)
 {
-    glDeleteProgram(programId);
+    sceneDraws[index].model = model;
+    sceneBounds[index] = meshBounds.Transform(model);
+    for (ScenePartition& partition : scenePartitions)
+    {
+        if (index < partition.first || index >= partition.first + partition.count)
+            continue;
+        if (partition.hierarchy.Size() > 0)
+            partition.hierarchy.Update(index - partition.first, sceneBounds[index]);
+        break;
+    }
 }
+
+// Key callback to handle key "P" to change to Ortho
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_RELEASE) return; //only handle press events
+    if (key == GLFW_KEY_P) 
+        UHandleInput(InputEvent::KeyPress(key));
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    // make sure the viewport matches the new window dimensions; note that width and 
+    // height will be significantly larger than specified on retina displays.
+    glViewport(0, 0, width, height);
+
+    // The projection follows on the next frame
+    framebufferWidth = width;
+    framebufferHeight = height;
+}
+
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow* window, double xpos, double ypos)
+{
+    if (firstMouse)
+    {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    UHandleInput(InputEvent::MouseMove(xoffset, yoffset));
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    /*
+     * Mouse Scroll changes speed
+     * Scrolling up increases speed
+     * Scrolling down decreases speed
+     */
+    UHandleInput(InputEvent::Scroll((float)yoffset));
+}
+
+void UDestroyTexture(GLuint textureId)
+{
+    glDeleteTextures(1, &textureId);
+}
+
+
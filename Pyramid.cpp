@@ -1,5 +1,9 @@
 #include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <vector>
+#include <algorithm>        // sort
+#include <chrono>
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 
@@ -8,6 +12,11 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "shader_program.h"
+#include "headless.h"
+#include "golden.h"
+#include "benchmark.h"
+
 using namespace std; // Standard namespace
 
 /*Shader program Macro*/
@@ -24,6 +33,10 @@ namespace
     const int WINDOW_WIDTH = 800;
     const int WINDOW_HEIGHT = 600;
 
+    // Frames rendered before and during timing in golden mode
+    const int GOLDEN_WARMUP_FRAMES = 10;
+    const int GOLDEN_FRAMES = 100;
+
     // Stores the GL data relative to a given mesh
     struct GLMesh
     {
@@ -37,7 +50,10 @@ namespace
     // Triangle mesh data
     GLMesh gMesh;
     // Shader program
-    GLuint gProgramId;
+    ShaderProgram gProgram;
+    GLint gModelLocation = -1;
+    // Camera matrices shared through a uniform buffer
+    CameraUniformBuffer gCameraBuffer;
 }
 
 /* User-defined Function prototypes to:
@@ -50,9 +66,10 @@ void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
 void UCreateMesh(GLMesh& mesh);
 void UDestroyMesh(GLMesh& mesh);
-void URender();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
-void UDestroyShaderProgram(GLuint programId);
+bool UCreateScene();
+void UDestroyScene();
+unsigned URender();
+bool URunGolden(const char* directory, bool update);
 
 
 /* Vertex Shader Source Code*/
@@ -63,9 +80,12 @@ layout(location = 1) in vec4 color;  // Color data from Vertex Attrib Pointer 1
 out vec4 vertexColor; // variable to transfer color data to the fragment shader
 
 //Global variables for the  transform matrices
+layout(std140, binding = 0) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
@@ -90,14 +110,34 @@ void main()
 
 int main(int argc, char* argv[])
 {
-    if (!UInitialize(argc, argv, &gWindow))
+    // --golden DIR         render the pyramid offscreen and compare image, frame time and draw calls with DIR
+    // --golden-update      write the references in the --golden directory instead of comparing
+    const char* goldenDirectory = nullptr;
+    bool goldenUpdate = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenDirectory = argv[++i];
+        else if (strcmp(argv[i], "--golden-update") == 0)
+            goldenUpdate = true;
+        else
+        {
+            cout << "Usage: " << argv[0] << " [--golden DIR [--golden-update]]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (goldenUpdate && !goldenDirectory)
+    {
+        cout << "--golden-update needs --golden DIR" << endl;
         return EXIT_FAILURE;
+    }
+    if (goldenDirectory)
+        return URunGolden(goldenDirectory, goldenUpdate) ? EXIT_SUCCESS : EXIT_FAILURE;
 
-    // Create the mesh
-    UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
+    if (!UInitialize(argc, argv, &gWindow))
+        return EXIT_FAILURE;
 
-    // Create the shader program
-    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
+    if (!UCreateScene())
         return EXIT_FAILURE;
 
     // Sets the background color of the window to black (it will be implicitely used by glClear)
@@ -114,14 +154,12 @@ int main(int argc, char* argv[])
         // Render this frame
         URender();
 
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
         glfwPollEvents();
     }
 
-    // Release mesh data
-    UDestroyMesh(gMesh);
-
-    // Release shader program
-    UDestroyShaderProgram(gProgramId);
+    UDestroyScene();
 
     exit(EXIT_SUCCESS); // Terminates the program successfully
 }
@@ -187,9 +225,11 @@ void UResizeWindow(GLFWwindow* window, int width, int height)
 }
 
 
-// Functioned called to render a frame
-void URender()
+// Functioned called to render a frame; returns the number of draw calls it issued
+unsigned URender()
 {
+    unsigned drawCalls = 0;
+
     // Enable z-depth
     glEnable(GL_DEPTH_TEST);
 
@@ -217,28 +257,92 @@ void URender()
     glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 
     // Set the shader to be used
-    glUseProgram(gProgramId);
+    gProgram.Use();
 
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // Camera matrices go through the shared uniform buffer, the model matrix through its cached location
+    gCameraBuffer.Update(view, projection);
+    glUniformMatrix4fv(gModelLocation, 1, GL_FALSE, glm::value_ptr(model));
 
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(gMesh.vao);
 
     // Draws the triangles
     glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    ++drawCalls;
 
     // Deactivate the Vertex Array Object
     glBindVertexArray(0);
 
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+    return drawCalls;
+}
+
+
+// Creates the mesh, shader program and camera buffer the frame is drawn with
+bool UCreateScene()
+{
+    // Create the mesh
+    UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
+
+    // Create the shader program
+    if (!gProgram.Build(vertexShaderSource, fragmentShaderSource))
+        return false;
+    gModelLocation = gProgram.Uniform("model");
+
+    gCameraBuffer.Create();
+    return true;
+}
+
+
+void UDestroyScene()
+{
+    // Release mesh data
+    UDestroyMesh(gMesh);
+
+    // Release shader program
+    gProgram.Destroy();
+    gCameraBuffer.Destroy();
+}
+
+
+// Golden mode: renders the fixed view offscreen at the window's size and checks its image, median frame time
+// and draw calls against DIR/pyramid_static.ppm and DIR/pyramid.perf
+bool URunGolden(const char* directory, bool update)
+{
+    headless::HeadlessContext context;
+    if (!context.Create(4, 4))
+        return false;
+
+    headless::OffscreenTarget target;
+    if (!target.Create(WINDOW_WIDTH, WINDOW_HEIGHT))
+        return false;
+    target.Bind();
+
+    if (!UCreateScene())
+        return false;
+
+    for (int i = 0; i < GOLDEN_WARMUP_FRAMES; ++i)
+        URender();
+    glFinish();
+
+    // Every frame is finished before the next starts, so its time includes the GPU work
+    vector<double> frameTimes;
+    unsigned drawCalls = 0;
+    for (int i = 0; i < GOLDEN_FRAMES; ++i)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        drawCalls = URender();
+        glFinish();
+        frameTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    sort(frameTimes.begin(), frameTimes.end());
+
+    GoldenSuite suite(directory, "pyramid", update);
+    suite.Check("static", ReadFramebuffer(WINDOW_WIDTH, WINDOW_HEIGHT), FrameBenchmark::Percentile(frameTimes, 0.5), drawCalls);
+    bool passed = suite.Report(cout);
+
+    UDestroyScene();
+    target.Destroy();
+    return passed;
 }
 
 
@@ -299,70 +403,3 @@ void UDestroyMesh(GLMesh& mesh)
     glDeleteBuffers(2, mesh.vbos);
 }
 
-
-// Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
-{
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
-
-    // Create a Shader program object.
-    programId = glCreateProgram();
-
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Retrive the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
-
-    // Compile the vertex shader, and print compilation errors (if any)
-    glCompileShader(vertexShaderId); // compile the vertex shader
-    // check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glCompileShader(fragmentShaderId); // compile the fragment shader
-    // check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
-
-    glLinkProgram(programId);   // links the shader program
-    // check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-
-        return false;
-    }
-
-    glUseProgram(programId);    // Uses the shader program
-
-    return true;
-}
-
-
-void UDestroyShaderProgram(GLuint programId)
-{
-    glDeleteProgram(programId);
-}
@@ -1,8 +1,16 @@
 #include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <vector>
+#include <algorithm>        // sort
+#include <chrono>
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 
+#include "headless.h"
+#include "golden.h"
+#include "benchmark.h"
+
 using namespace std; // Uses the standard namespace
 
 // Unnamed namespace
@@ -14,6 +22,10 @@ namespace
     const int WINDOW_WIDTH = 800;
     const int WINDOW_HEIGHT = 600;
 
+    // Frames rendered before and during timing in golden mode
+    const int GOLDEN_WARMUP_FRAMES = 10;
+    const int GOLDEN_FRAMES = 100;
+
     // Stores the GL data relative to a given mesh
     struct GLMesh
     {
@@ -40,9 +52,12 @@ void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
 void UCreateMesh(GLMesh& mesh);
 void UDestroyMesh(GLMesh& mesh);
-void URender();
+unsigned URender();
 bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
 void UDestroyShaderProgram(GLuint programId);
+bool UCreateScene();
+void UDestroyScene();
+bool URunGolden(const char* directory, bool update);
 
 
 // Vertex Shader Program Source Code
@@ -70,14 +85,34 @@ const char* fragmentShaderSource = "#version 440 core\n"
 // main function. Entry point to the OpenGL program
 int main(int argc, char* argv[])
 {
-    if (!UInitialize(argc, argv, &gWindow))
+    // --golden DIR         render the triangles offscreen and compare image, frame time and draw calls with DIR
+    // --golden-update      write the references in the --golden directory instead of comparing
+    const char* goldenDirectory = nullptr;
+    bool goldenUpdate = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenDirectory = argv[++i];
+        else if (strcmp(argv[i], "--golden-update") == 0)
+            goldenUpdate = true;
+        else
+        {
+            cout << "Usage: " << argv[0] << " [--golden DIR [--golden-update]]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (goldenUpdate && !goldenDirectory)
+    {
+        cout << "--golden-update needs --golden DIR" << endl;
         return EXIT_FAILURE;
+    }
+    if (goldenDirectory)
+        return URunGolden(goldenDirectory, goldenUpdate) ? EXIT_SUCCESS : EXIT_FAILURE;
 
-    // Create the mesh
-    UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
+    if (!UInitialize(argc, argv, &gWindow))
+        return EXIT_FAILURE;
 
-    // Create the shader program
-    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
+    if (!UCreateScene())
         return EXIT_FAILURE;
 
     // Sets the background color of the window to black (it will be implicitely used by glClear)
@@ -94,14 +129,12 @@ int main(int argc, char* argv[])
         // Render this frame
         URender();
 
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
         glfwPollEvents();
     }
 
-    // Release mesh data
-    UDestroyMesh(gMesh);
-
-    // Release shader program
-    UDestroyShaderProgram(gProgramId);
+    UDestroyScene();
 
     exit(EXIT_SUCCESS); // Terminates the program successfully
 }
@@ -167,9 +200,11 @@ void UResizeWindow(GLFWwindow* window, int width, int height)
 }
 
 
-// Functioned called to render a frame
-void URender()
+// Functioned called to render a frame; returns the number of draw calls it issued
+unsigned URender()
 {
+    unsigned drawCalls = 0;
+
     // Clear the background
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -182,12 +217,12 @@ void URender()
 
     // Draws the triangle
     glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    ++drawCalls;
 
     // Deactivate the VAO
     glBindVertexArray(0);
 
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+    return drawCalls;
 }
 
 
@@ -288,6 +323,8 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
     {
         glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(vertexShaderId);
+        glDeleteShader(fragmentShaderId);
 
         return false;
     }
@@ -299,6 +336,8 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
     {
         glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
         std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(vertexShaderId);
+        glDeleteShader(fragmentShaderId);
 
         return false;
     }
@@ -308,6 +347,12 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
     glAttachShader(programId, fragmentShaderId);
 
     glLinkProgram(programId);   // links the shader program
+
+    // The linked program keeps its own copy; the shader objects are no longer needed
+    glDetachShader(programId, vertexShaderId);
+    glDetachShader(programId, fragmentShaderId);
+    glDeleteShader(vertexShaderId);
+    glDeleteShader(fragmentShaderId);
     // check for linking errors
     glGetProgramiv(programId, GL_LINK_STATUS, &success);
     if (!success)
@@ -329,3 +374,65 @@ void UDestroyShaderProgram(GLuint programId)
     glDeleteProgram(programId);
 }
 
+
+// Creates the mesh and shader program the frame is drawn with
+bool UCreateScene()
+{
+    // Create the mesh
+    UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
+
+    // Create the shader program
+    return UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId);
+}
+
+
+void UDestroyScene()
+{
+    // Release mesh data
+    UDestroyMesh(gMesh);
+
+    // Release shader program
+    UDestroyShaderProgram(gProgramId);
+}
+
+
+// Golden mode: renders the triangles offscreen at the window's size and checks their image, median frame time
+// and draw calls against DIR/triangles_static.ppm and DIR/triangles.perf
+bool URunGolden(const char* directory, bool update)
+{
+    headless::HeadlessContext context;
+    if (!context.Create(4, 4))
+        return false;
+
+    headless::OffscreenTarget target;
+    if (!target.Create(WINDOW_WIDTH, WINDOW_HEIGHT))
+        return false;
+    target.Bind();
+
+    if (!UCreateScene())
+        return false;
+
+    for (int i = 0; i < GOLDEN_WARMUP_FRAMES; ++i)
+        URender();
+    glFinish();
+
+    // Every frame is finished before the next starts, so its time includes the GPU work
+    vector<double> frameTimes;
+    unsigned drawCalls = 0;
+    for (int i = 0; i < GOLDEN_FRAMES; ++i)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        drawCalls = URender();
+        glFinish();
+        frameTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    sort(frameTimes.begin(), frameTimes.end());
+
+    GoldenSuite suite(directory, "triangles", update);
+    suite.Check("static", ReadFramebuffer(WINDOW_WIDTH, WINDOW_HEIGHT), FrameBenchmark::Percentile(frameTimes, 0.5), drawCalls);
+    bool passed = suite.Report(cout);
+
+    UDestroyScene();
+    target.Destroy();
+    return passed;
+}
@@ -0,0 +1,126 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <iostream>         // cout
+#include <iomanip>          // setw, setprecision
+#include <vector>
+#include <algorithm>        // sort
+#include <chrono>
+#include <GL/glew.h>        // GLEW library
+
+/*
+ * Collects CPU and GPU frame times and prints min/avg/p50/p95/p99.
+ *
+ * CPU time is measured from BeginFrame() to EndFrame() on the calling thread.
+ * GPU time comes from GL_TIME_ELAPSED queries kept in a small ring, so a result
+ * is only read back once the GPU is several frames past it.
+ */
+class FrameBenchmark
+{
+public:
+    FrameBenchmark()
+    {
+        glGenQueries(QUERY_RING_SIZE, mQueries);
+
+        // Mesa llvmpipe reports garbage for the first timer query that contains any GPU work,
+        // so spend that one on a depth clear (the scene clears it again every frame) and discard it
+        GLuint64 discarded;
+        glBeginQuery(GL_TIME_ELAPSED, mQueries[0]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEndQuery(GL_TIME_ELAPSED);
+        glGetQueryObjectui64v(mQueries[0], GL_QUERY_RESULT, &discarded);
+    }
+
+    ~FrameBenchmark()
+    {
+        glDeleteQueries(QUERY_RING_SIZE, mQueries);
+    }
+
+    void BeginFrame()
+    {
+        // Reuse the oldest query only after collecting its result
+        GLuint slot = mFrameIndex % QUERY_RING_SIZE;
+        if (mFrameIndex >= QUERY_RING_SIZE)
+            CollectGpuTime(slot);
+
+        mCpuStart = std::chrono::steady_clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, mQueries[slot]);
+    }
+
+    void EndFrame()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - mCpuStart;
+        mCpuTimes.push_back(elapsed.count());
+        ++mFrameIndex;
+    }
+
+    // Waits for the queries still in flight; call before Report()
+    void Finish()
+    {
+        GLuint pending = mFrameIndex < QUERY_RING_SIZE ? mFrameIndex : QUERY_RING_SIZE;
+        for (GLuint i = pending; i > 0; --i)
+            CollectGpuTime((mFrameIndex - i) % QUERY_RING_SIZE);
+        mFrameIndex = 0;
+    }
+
+    void Report(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(3);
+        out << "        " << std::setw(9) << "min" << std::setw(9) << "avg" << std::setw(9) << "p50"
+            << std::setw(9) << "p95" << std::setw(9) << "p99" << "   (ms, " << mCpuTimes.size() << " frames)" << std::endl;
+        PrintRow(out, "CPU", mCpuTimes);
+        PrintRow(out, "GPU", mGpuTimes);
+    }
+
+    // One "label  min avg p50 p95 p99" line, aligned with Report()'s header; also used by other reports
+    static void PrintRow(std::ostream& out, const char* label, std::vector<double> samples)
+    {
+        out << "  " << std::left << std::setw(6) << label << std::right;
+        if (samples.empty())
+        {
+            out << "  (no samples)" << std::endl;
+            return;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (double sample : samples)
+            sum += sample;
+
+        out << std::setw(9) << samples.front()
+            << std::setw(9) << sum / samples.size()
+            << std::setw(9) << Percentile(samples, 0.50)
+            << std::setw(9) << Percentile(samples, 0.95)
+            << std::setw(9) << Percentile(samples, 0.99) << std::endl;
+    }
+
+    // Nearest-rank percentile of an already sorted sample set
+    static double Percentile(const std::vector<double>& sorted, double fraction)
+    {
+        size_t rank = (size_t)(fraction * sorted.size() + 0.5);
+        if (rank > 0)
+            --rank;
+        if (rank >= sorted.size())
+            rank = sorted.size() - 1;
+        return sorted[rank];
+    }
+
+private:
+    static const GLuint QUERY_RING_SIZE = 4;
+
+    GLuint mQueries[QUERY_RING_SIZE];
+    GLuint mFrameIndex = 0;
+    std::chrono::steady_clock::time_point mCpuStart;
+    std::vector<double> mCpuTimes;
+    std::vector<double> mGpuTimes;
+
+    void CollectGpuTime(GLuint slot)
+    {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(mQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+        mGpuTimes.push_back(nanoseconds / 1.0e6);
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>        // sort
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+/*
+ * One object to draw: the state it needs plus its per-instance data.
+ * Geometry is a range of a shared vertex array (see MeshRegistry). Programs,
+ * textures and vertex arrays are plain handles here; nothing touches GL until
+ * the render queue replays the item.
+ */
+struct DrawItem
+{
+    uint64_t key = 0;                   // Filled in by CommandList::Push or RenderQueue::Push
+    GLuint program = 0;
+    GLuint textures[2] = { 0, 0 };      // Bound to texture units 0 and 1 (0 = unused)
+    GLuint vao = 0;
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0;              // In indices of indexType
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    glm::mat4 model = glm::mat4(1.0f);
+    GLint flags = 0;
+};
+
+/*
+ * 64-bit state key of a draw, most significant first:
+ *     program (12 bits) | texture set (20 bits) | geometry (16 bits) | depth (16 bits)
+ * so draws are grouped by program, then textures, then geometry (vertex array,
+ * then mesh range), and drawn front to back within a group. viewDepth is the
+ * distance along the view direction, in [0, maxDepth).
+ *
+ * The texture set and geometry fields are hashes of the handles, so the key
+ * depends on nothing but the item and any thread can compute it. A collision
+ * only interleaves two groups; batching still compares the actual state.
+ */
+inline uint64_t DrawSortKey(const DrawItem& item, float viewDepth, float maxDepth)
+{
+    float normalizedDepth = glm::clamp(viewDepth / maxDepth, 0.0f, 1.0f);
+    uint64_t depth = (uint64_t)(normalizedDepth * 0xFFFF);
+
+    // 4 bits of vertex array, 12 bits identifying the mesh range within it
+    uint64_t range = ((uint64_t)item.baseVertex * 2654435761u) ^ ((uint64_t)item.firstIndex * 40503u);
+    uint64_t geometry = ((uint64_t)(item.vao & 0xF) << 12) | ((range >> 4) & 0xFFF);
+
+    uint64_t set = ((uint64_t)item.textures[0] << 32) | item.textures[1];
+    uint64_t textureSet = (set * 0x9E3779B97F4A7C15ull) >> 44;
+
+    return ((uint64_t)(item.program & 0xFFF) << 52) | (textureSet << 32) | (geometry << 16) | depth;
+}
+
+/*
+ * Draws recorded by one thread, typically for one part of the scene. Recording
+ * only fills in memory the list owns, so several threads can record their own
+ * lists at once; the GL thread then merges the sorted lists into its
+ * RenderQueue (RenderQueue::Append) and submits them.
+ */
+class CommandList
+{
+public:
+    void Clear()
+    {
+        mItems.clear();
+    }
+
+    void Push(const DrawItem& item, float viewDepth, float maxDepth)
+    {
+        mItems.push_back(item);
+        mItems.back().key = DrawSortKey(item, viewDepth, maxDepth);
+    }
+
+    void Sort()
+    {
+        std::sort(mItems.begin(), mItems.end(),
+            [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+    }
+
+    const std::vector<DrawItem>& Items() const
+    {
+        return mItems;
+    }
+
+    size_t Size() const
+    {
+        return mItems.size();
+    }
+
+private:
+    std::vector<DrawItem> mItems;
+};
+
+#endif
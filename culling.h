@@ -0,0 +1,319 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cstdint>
+#include <cmath>            // fabs
+#include <vector>
+#include <algorithm>        // min, max, nth_element
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>      // SSE2
+#define CULLING_SSE2 1
+#endif
+
+/*
+ * Axis-aligned box with its bounding sphere, both centered on the box.
+ * Meshes keep one in model space; Transform() gives the world-space bounds of
+ * an instance, which is what the frustum and the hierarchy are tested against.
+ */
+struct Bounds
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 extents = glm::vec3(-1.0f);   // Half size; negative while empty
+    float radius = 0.0f;
+
+    static Bounds FromMinMax(const glm::vec3& min, const glm::vec3& max)
+    {
+        Bounds bounds;
+        bounds.center = (min + max) * 0.5f;
+        bounds.extents = (max - min) * 0.5f;
+        bounds.radius = glm::length(bounds.extents);
+        return bounds;
+    }
+
+    bool Empty() const
+    {
+        return extents.x < 0.0f;
+    }
+
+    glm::vec3 Min() const { return center - extents; }
+    glm::vec3 Max() const { return center + extents; }
+
+    void Add(const glm::vec3& point)
+    {
+        *this = Empty() ? FromMinMax(point, point) : FromMinMax(glm::min(Min(), point), glm::max(Max(), point));
+    }
+
+    void Add(const Bounds& other)
+    {
+        if (other.Empty())
+            return;
+        *this = Empty() ? other : FromMinMax(glm::min(Min(), other.Min()), glm::max(Max(), other.Max()));
+    }
+
+    // Box around this box after an affine transform (Arvo: the extents go through |M|)
+    Bounds Transform(const glm::mat4& model) const
+    {
+        if (Empty())
+            return *this;
+        glm::mat3 linear(model);
+        glm::mat3 absolute(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+        Bounds bounds;
+        bounds.center = glm::vec3(model * glm::vec4(center, 1.0f));
+        bounds.extents = absolute * extents;
+        bounds.radius = glm::length(bounds.extents);
+        return bounds;
+    }
+
+    bool operator==(const Bounds& other) const
+    {
+        return center == other.center && extents == other.extents;
+    }
+};
+
+
+/*
+ * The six planes of a view frustum, normals pointing inwards, extracted from
+ * projection * view (Gribb/Hartmann), so perspective and ortho work alike.
+ * The planes are stored as columns (all x, then all y, ...) padded to eight,
+ * which lets the SSE path test a box against four planes per instruction.
+ */
+class Frustum
+{
+public:
+    static const unsigned PLANE_COUNT = 6;
+    static const unsigned ALL_PLANES = (1u << PLANE_COUNT) - 1;
+
+    // Identity: the clip volume itself
+    Frustum() : Frustum(glm::mat4(1.0f)) {}
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        glm::mat4 m = glm::transpose(viewProjection);   // Rows of the matrix as columns
+        glm::vec4 planes[PLANE_COUNT] = {
+            m[3] + m[0], m[3] - m[0],   // left, right
+            m[3] + m[1], m[3] - m[1],   // bottom, top
+            m[3] + m[2], m[3] - m[2],   // near, far
+        };
+
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            // Padding planes accept everything
+            glm::vec4 plane = i < PLANE_COUNT ? planes[i] / glm::length(glm::vec3(planes[i])) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            mX[i] = plane.x;
+            mY[i] = plane.y;
+            mZ[i] = plane.z;
+            mW[i] = plane.w;
+            mAbsX[i] = std::fabs(plane.x);
+            mAbsY[i] = std::fabs(plane.y);
+            mAbsZ[i] = std::fabs(plane.z);
+        }
+    }
+
+    // Mask of the planes the box straddles, or -1 when it is entirely outside one of them.
+    // Only planes in planeMask are tested; a box fully inside a parent can skip the parent's planes.
+    int Classify(const Bounds& bounds, unsigned planeMask = ALL_PLANES) const
+    {
+#ifdef CULLING_SSE2
+        __m128 cx = _mm_set1_ps(bounds.center.x), cy = _mm_set1_ps(bounds.center.y), cz = _mm_set1_ps(bounds.center.z);
+        __m128 ex = _mm_set1_ps(bounds.extents.x), ey = _mm_set1_ps(bounds.extents.y), ez = _mm_set1_ps(bounds.extents.z);
+        unsigned outside = 0, straddling = 0;
+        for (unsigned i = 0; i < 8; i += 4)
+        {
+            // distance = n . c + w, reach = |n| . e
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(mX + i), cx), _mm_mul_ps(_mm_load_ps(mY + i), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_load_ps(mZ + i), cz), _mm_load_ps(mW + i)));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(mAbsX + i), ex), _mm_mul_ps(_mm_load_ps(mAbsY + i), ey)),
+                _mm_mul_ps(_mm_load_ps(mAbsZ + i), ez));
+            outside |= (unsigned)_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps())) << i;
+            straddling |= (unsigned)_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, reach), _mm_setzero_ps())) << i;
+        }
+        if (outside & planeMask)
+            return -1;
+        return (int)(straddling & planeMask);
+#else
+        unsigned straddling = 0;
+        for (unsigned i = 0; i < PLANE_COUNT; ++i)
+        {
+            if (!(planeMask & (1u << i)))
+                continue;
+            float distance = mX[i] * bounds.center.x + mY[i] * bounds.center.y + mZ[i] * bounds.center.z + mW[i];
+            float reach = mAbsX[i] * bounds.extents.x + mAbsY[i] * bounds.extents.y + mAbsZ[i] * bounds.extents.z;
+            if (distance + reach < 0.0f)
+                return -1;
+            if (distance - reach < 0.0f)
+                straddling |= 1u << i;
+        }
+        return (int)straddling;
+#endif
+    }
+
+    bool Visible(const Bounds& bounds) const
+    {
+        // The sphere rejects most far-away objects with one plane test before the box test
+        for (unsigned i = 0; i < PLANE_COUNT; ++i)
+            if (mX[i] * bounds.center.x + mY[i] * bounds.center.y + mZ[i] * bounds.center.z + mW[i] < -bounds.radius)
+                return false;
+        return Classify(bounds) >= 0;
+    }
+
+private:
+    alignas(16) float mX[8];
+    alignas(16) float mY[8];
+    alignas(16) float mZ[8];
+    alignas(16) float mW[8];
+    alignas(16) float mAbsX[8];
+    alignas(16) float mAbsY[8];
+    alignas(16) float mAbsZ[8];
+};
+
+
+/*
+ * Bounding volume hierarchy over world-space object bounds, for scenes large
+ * enough that testing every object each frame costs more than walking a tree.
+ *
+ * Build() splits at the median of the longest axis, down to a few objects per
+ * leaf. When an object moves, Update() refits its leaf and the boxes above it
+ * without changing the tree's shape; rebuild if objects drift far from where
+ * they were when the tree was built.
+ */
+class BoundingVolumeHierarchy
+{
+public:
+    void Build(const std::vector<Bounds>& objects)
+    {
+        mNodes.clear();
+        mObjects.resize(objects.size());
+        mLeafOf.assign(objects.size(), 0);
+        for (uint32_t i = 0; i < (uint32_t)objects.size(); ++i)
+            mObjects[i] = i;
+        mBounds = objects;
+        if (!objects.empty())
+            BuildNode(0, (uint32_t)objects.size(), NO_NODE);
+    }
+
+    // Moves one object and refits the boxes on the path to the root
+    void Update(uint32_t object, const Bounds& bounds)
+    {
+        mBounds[object] = bounds;
+        for (uint32_t node = mLeafOf[object]; node != NO_NODE; node = mNodes[node].parent)
+        {
+            Bounds refit = NodeBounds(node);
+            if (refit == mNodes[node].bounds)
+                break;  // Nothing above can change either
+            mNodes[node].bounds = refit;
+        }
+    }
+
+    // Appends the indices of the objects whose boxes intersect the frustum
+    void Query(const Frustum& frustum, std::vector<uint32_t>& visible) const
+    {
+        if (!mNodes.empty())
+            QueryNode(0, frustum, Frustum::ALL_PLANES, visible);
+    }
+
+    size_t Size() const
+    {
+        return mBounds.size();
+    }
+
+private:
+    static const uint32_t NO_NODE = ~0u;
+    static const uint32_t MAX_LEAF_OBJECTS = 4;
+
+    // Leaves cover mObjects[first, first + count); inner nodes have count 0 and two children
+    struct Node
+    {
+        Bounds bounds;
+        uint32_t parent;
+        uint32_t left = NO_NODE;
+        uint32_t right = NO_NODE;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mObjects;     // Object indices, grouped by leaf
+    std::vector<uint32_t> mLeafOf;      // Leaf node of each object
+    std::vector<Bounds> mBounds;        // Current bounds of each object
+
+    uint32_t BuildNode(uint32_t first, uint32_t count, uint32_t parent)
+    {
+        uint32_t index = (uint32_t)mNodes.size();
+        mNodes.push_back(Node());
+        mNodes[index].parent = parent;
+
+        if (count <= MAX_LEAF_OBJECTS)
+        {
+            mNodes[index].first = first;
+            mNodes[index].count = count;
+            for (uint32_t i = first; i < first + count; ++i)
+                mLeafOf[mObjects[i]] = index;
+            mNodes[index].bounds = NodeBounds(index);
+            return index;
+        }
+
+        // Split on the longest axis of the centers
+        Bounds centers;
+        for (uint32_t i = first; i < first + count; ++i)
+            centers.Add(mBounds[mObjects[i]].center);
+        int axis = 0;
+        if (centers.extents.y > centers.extents[axis]) axis = 1;
+        if (centers.extents.z > centers.extents[axis]) axis = 2;
+
+        uint32_t half = count / 2;
+        std::nth_element(mObjects.begin() + first, mObjects.begin() + first + half, mObjects.begin() + first + count,
+            [this, axis](uint32_t a, uint32_t b) { return mBounds[a].center[axis] < mBounds[b].center[axis]; });
+
+        uint32_t left = BuildNode(first, half, index);
+        uint32_t right = BuildNode(first + half, count - half, index);
+        mNodes[index].left = left;
+        mNodes[index].right = right;
+        mNodes[index].bounds = NodeBounds(index);
+        return index;
+    }
+
+    Bounds NodeBounds(uint32_t index) const
+    {
+        const Node& node = mNodes[index];
+        Bounds bounds;
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                bounds.Add(mBounds[mObjects[i]]);
+        }
+        else
+        {
+            bounds.Add(mNodes[node.left].bounds);
+            bounds.Add(mNodes[node.right].bounds);
+        }
+        return bounds;
+    }
+
+    void QueryNode(uint32_t index, const Frustum& frustum, unsigned planeMask, std::vector<uint32_t>& visible) const
+    {
+        const Node& node = mNodes[index];
+        if (planeMask != 0)
+        {
+            int straddling = frustum.Classify(node.bounds, planeMask);
+            if (straddling < 0)
+                return;
+            planeMask = (unsigned)straddling;   // Planes the node is fully inside of hold for its children too
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                if (planeMask == 0 || frustum.Classify(mBounds[mObjects[i]], planeMask) >= 0)
+                    visible.push_back(mObjects[i]);
+            return;
+        }
+        QueryNode(node.left, frustum, planeMask, visible);
+        QueryNode(node.right, frustum, planeMask, visible);
+    }
+};
+
+#endif
@@ -0,0 +1,373 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <iostream>         // cout
+#include <iomanip>          // setw, setfill, setprecision
+#include <sstream>
+#include <cstdio>           // fopen, fwrite
+#include <cstring>          // strcmp
+#include <string>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>        // GLEW library
+
+#include "golden.h"         // Image, WriteImage
+
+/*
+ * Where captured frames go:
+ *
+ *     ppm   one <prefix>_NNNNNN.ppm per frame
+ *     raw   every frame appended to <prefix>.rgba, top row first, for
+ *           ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i <prefix>.rgba ...
+ */
+enum class CaptureFormat { Ppm, Raw };
+
+inline bool ParseCaptureFormat(const char* name, CaptureFormat& format)
+{
+    if (strcmp(name, "ppm") == 0)
+        format = CaptureFormat::Ppm;
+    else if (strcmp(name, "raw") == 0)
+        format = CaptureFormat::Raw;
+    else
+        return false;
+    return true;
+}
+
+/*
+ * Captures every rendered frame without stalling the render loop on it.
+ *
+ * Capture() only queues a glReadPixels into one of RING_SIZE pixel pack
+ * buffers and fences it; the buffers are mapped once for their lifetime
+ * (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT), like UploadRing's. Once a
+ * readback's fence has signaled, a later Capture() hands its buffer to a
+ * writer thread, which flips and converts the pixels and writes them while
+ * the GL thread renders on. The GL thread only waits when it comes back to a
+ * buffer whose readback has still not finished or which the writer has not
+ * got through yet; Report() counts both.
+ *
+ *     capture.Create("frames", CaptureFormat::Ppm);
+ *     ...render frame...
+ *     capture.Capture(width, height);     // before the swap
+ *     ...
+ *     capture.Finish();                   // writes what is still in flight
+ */
+class FrameCapture
+{
+public:
+    static const unsigned RING_SIZE = 4;
+
+    ~FrameCapture()
+    {
+        Finish();
+    }
+
+    bool Create(const std::string& prefix, CaptureFormat format)
+    {
+        Finish();
+        mPrefix = prefix;
+        mFormat = format;
+        if (mFormat == CaptureFormat::Raw)
+        {
+            mRawFile = fopen((mPrefix + ".rgba").c_str(), "wb");
+            if (!mRawFile)
+            {
+                std::cout << "Could not create " << mPrefix << ".rgba" << std::endl;
+                return false;
+            }
+        }
+
+        mFrames = 0;
+        mWritten = 0;
+        mSkipped = 0;
+        mFailed = 0;
+        mGpuWaits = 0;
+        mWriterWaits = 0;
+        mCaptureTime = 0.0;
+        mRawWidth = 0;
+        mRawHeight = 0;
+        mStop = false;
+        mWriter = std::thread(&FrameCapture::WriterLoop, this);
+        return true;
+    }
+
+    // Queues a readback of the bound read framebuffer's color buffer; call once the frame is drawn
+    void Capture(int width, int height)
+    {
+        if (!mWriter.joinable() || width <= 0 || height <= 0)
+            return;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (width != mWidth || height != mHeight)
+            Resize(width, height);
+
+        // Pass on everything already read back, then make sure the next buffer is free
+        while (HandOff(false))
+            ;
+        Slot& slot = mSlots[mNext];
+        bool waitedForGpu = slot.fence != 0;
+        if (waitedForGpu)
+        {
+            ++mGpuWaits;
+            while (slot.fence)
+                HandOff(true);
+        }
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (slot.writing && !waitedForGpu)
+                ++mWriterWaits;
+            mChanged.wait(lock, [&slot]() { return !slot.writing; });
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = mFrames++;
+        mInFlight.push_back(mNext);
+        mNext = (mNext + 1) % RING_SIZE;
+
+        mCaptureTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Waits for every frame captured so far to be written, then stops the writer and releases the buffers
+    void Finish()
+    {
+        if (!mWriter.joinable())
+            return;
+
+        while (HandOff(true))
+            ;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mChanged.notify_all();
+        mWriter.join();
+
+        if (mRawFile && fclose(mRawFile) != 0)
+            ++mFailed;
+        mRawFile = nullptr;
+        DestroyBuffers();
+    }
+
+    // Call after Finish()
+    void Report(std::ostream& out) const
+    {
+        out << "Capture: " << mWritten << " of " << mFrames << " frames written to " << mPrefix
+            << (mFormat == CaptureFormat::Raw ? ".rgba" : "_*.ppm") << std::endl;
+        out << std::fixed << std::setprecision(3);
+        out << "  " << (mFrames > 0 ? mCaptureTime / mFrames : 0.0) << " ms per frame on the render thread, waited "
+            << mGpuWaits << " times for a readback and " << mWriterWaits << " times for the writer" << std::endl;
+        if (mSkipped > 0)
+            out << "  " << mSkipped << " frames skipped, their size differs from the video's " << mRawWidth << "x" << mRawHeight << std::endl;
+        if (mFailed > 0)
+            out << "  " << mFailed << " frames could not be written" << std::endl;
+        if (mFormat == CaptureFormat::Raw && mRawWidth > 0)
+            out << "  ffmpeg -f rawvideo -pix_fmt rgba -s " << mRawWidth << "x" << mRawHeight << " -i " << mPrefix << ".rgba ..." << std::endl;
+    }
+
+private:
+    struct Slot
+    {
+        GLuint buffer = 0;
+        const unsigned char* mapped = nullptr;
+        GLsync fence = 0;       // Set while the readback may still be running
+        bool writing = false;   // Set while queued for or held by the writer; guarded by mMutex
+        unsigned frame = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    std::string mPrefix;
+    CaptureFormat mFormat = CaptureFormat::Ppm;
+    FILE* mRawFile = nullptr;
+    int mRawWidth = 0;          // Size of the first frame written to the raw video
+    int mRawHeight = 0;
+
+    Slot mSlots[RING_SIZE];
+    unsigned mNext = 0;         // Slot the next readback goes to
+    std::deque<unsigned> mInFlight;     // Slots with a fence, oldest first
+    int mWidth = 0;
+    int mHeight = 0;
+
+    std::thread mWriter;
+    std::mutex mMutex;
+    std::condition_variable mChanged;   // A slot was queued or written, or the writer should stop
+    std::deque<unsigned> mQueue;        // Slots for the writer, in frame order
+    bool mStop = false;
+
+    unsigned mFrames = 0;
+    unsigned mWritten = 0;      // Guarded by mMutex, like the other counters the writer updates
+    unsigned mSkipped = 0;
+    unsigned mFailed = 0;
+    unsigned mGpuWaits = 0;
+    unsigned mWriterWaits = 0;
+    double mCaptureTime = 0.0;  // Milliseconds spent in Capture()
+
+    // Gives the oldest readback to the writer once it finished, or after waiting for it; false when there is none to give
+    bool HandOff(bool wait)
+    {
+        if (mInFlight.empty())
+            return false;
+
+        unsigned index = mInFlight.front();
+        Slot& slot = mSlots[index];
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        mInFlight.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            slot.writing = true;
+            mQueue.push_back(index);
+        }
+        mChanged.notify_all();
+        return true;
+    }
+
+    // Reallocates the buffers for a new framebuffer size, once everything in them is written
+    void Resize(int width, int height)
+    {
+        while (HandOff(true))
+            ;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mChanged.wait(lock, [this]() { return mQueue.empty() && !AnyWriting(); });
+        }
+        DestroyBuffers();
+
+        GLsizeiptr size = (GLsizeiptr)width * height * 4;
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        for (Slot& slot : mSlots)
+        {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferStorage(GL_PIXEL_PACK_BUFFER, size, NULL, flags | GL_CLIENT_STORAGE_BIT);
+            slot.mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags);
+            slot.width = width;
+            slot.height = height;
+            if (!slot.mapped)
+                std::cout << "Failed to map a capture buffer of " << size << " bytes" << std::endl;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        mWidth = width;
+        mHeight = height;
+        mNext = 0;
+    }
+
+    void DestroyBuffers()
+    {
+        for (Slot& slot : mSlots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.mapped)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &slot.buffer);
+            slot = Slot();
+        }
+        mInFlight.clear();
+        mWidth = 0;
+        mHeight = 0;
+    }
+
+    bool AnyWriting() const
+    {
+        for (const Slot& slot : mSlots)
+        {
+            if (slot.writing)
+                return true;
+        }
+        return false;
+    }
+
+    void WriterLoop()
+    {
+        for (;;)
+        {
+            unsigned index;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mChanged.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+                if (mQueue.empty())
+                    return;
+                index = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            int result = Write(mSlots[index]);
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mSlots[index].writing = false;
+                if (result > 0)
+                    ++mWritten;
+                else if (result == 0)
+                    ++mSkipped;
+                else
+                    ++mFailed;
+            }
+            mChanged.notify_all();
+        }
+    }
+
+    // Runs on the writer thread; 1 when written, 0 when skipped, -1 on failure
+    int Write(const Slot& slot)
+    {
+        if (!slot.mapped)
+            return -1;
+
+        // GL reads the bottom row first
+        size_t stride = (size_t)slot.width * 4;
+        if (mFormat == CaptureFormat::Raw)
+        {
+            if (mRawWidth == 0)
+            {
+                mRawWidth = slot.width;
+                mRawHeight = slot.height;
+            }
+            if (slot.width != mRawWidth || slot.height != mRawHeight)
+                return 0;
+            for (int y = slot.height - 1; y >= 0; --y)
+            {
+                if (fwrite(slot.mapped + y * stride, 1, stride, mRawFile) != stride)
+                    return -1;
+            }
+            return 1;
+        }
+
+        Image image;
+        image.width = slot.width;
+        image.height = slot.height;
+        image.pixels.resize((size_t)slot.width * slot.height * 3);
+        unsigned char* rgb = image.pixels.data();
+        for (int y = slot.height - 1; y >= 0; --y)
+        {
+            const unsigned char* rgba = slot.mapped + y * stride;
+            for (int x = 0; x < slot.width; ++x, rgba += 4, rgb += 3)
+            {
+                rgb[0] = rgba[0];
+                rgb[1] = rgba[1];
+                rgb[2] = rgba[2];
+            }
+        }
+
+        std::ostringstream path;
+        path << mPrefix << "_" << std::setw(6) << std::setfill('0') << slot.frame << ".ppm";
+        return WriteImage(path.str(), image) ? 1 : -1;
+    }
+};
+
+#endif
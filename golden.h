@@ -0,0 +1,267 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <iostream>         // cout
+#include <iomanip>          // setw, setprecision
+#include <fstream>
+#include <sstream>
+#include <cstdio>           // fopen, fread, fwrite, fscanf
+#include <cstdlib>          // abs
+#include <string>
+#include <algorithm>        // copy, max
+#include <vector>
+#include <map>
+#include <GL/glew.h>        // GLEW library
+
+// 8-bit RGB pixels, top row first
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Reads the color buffer of the bound read framebuffer
+inline Image ReadFramebuffer(int width, int height)
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t)width * height * 3);
+
+    std::vector<unsigned char> rows(image.pixels.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+
+    // GL returns the bottom row first
+    size_t stride = (size_t)width * 3;
+    for (int y = 0; y < height; ++y)
+        std::copy(rows.begin() + (height - 1 - y) * stride, rows.begin() + (height - y) * stride, image.pixels.begin() + y * stride);
+    return image;
+}
+
+// Binary PPM (P6), which any image viewer opens and needs no library to write
+inline bool WriteImage(const std::string& path, const Image& image)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fprintf(file, "P6\n%d %d\n255\n", image.width, image.height) > 0
+        && fwrite(image.pixels.data(), 1, image.pixels.size(), file) == image.pixels.size();
+    return fclose(file) == 0 && written;
+}
+
+inline bool ReadImage(const std::string& path, Image& image)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    int maxValue = 0;
+    bool read = fscanf(file, "P6 %d %d %d", &image.width, &image.height, &maxValue) == 3 && maxValue == 255
+        && image.width > 0 && image.height > 0 && fgetc(file) != EOF;    // The single whitespace before the pixels
+    if (read)
+    {
+        image.pixels.resize((size_t)image.width * image.height * 3);
+        read = fread(image.pixels.data(), 1, image.pixels.size(), file) == image.pixels.size();
+    }
+    fclose(file);
+    return read;
+}
+
+struct ImageDifference
+{
+    double mismatched = 1.0;    // Fraction of pixels with a channel off by more than the tolerance
+    int largest = 255;          // Largest channel difference anywhere
+};
+
+// Images of different sizes mismatch everywhere
+inline ImageDifference CompareImages(const Image& a, const Image& b, int tolerance)
+{
+    ImageDifference difference;
+    if (a.width != b.width || a.height != b.height)
+        return difference;
+
+    size_t pixelCount = (size_t)a.width * a.height;
+    size_t mismatched = 0;
+    difference.largest = 0;
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        int pixelLargest = 0;
+        for (size_t c = i * 3; c < i * 3 + 3; ++c)
+            pixelLargest = std::max(pixelLargest, std::abs((int)a.pixels[c] - (int)b.pixels[c]));
+        if (pixelLargest > tolerance)
+            ++mismatched;
+        difference.largest = std::max(difference.largest, pixelLargest);
+    }
+    difference.mismatched = pixelCount > 0 ? (double)mismatched / pixelCount : 0.0;
+    return difference;
+}
+
+// How far a run may stray from the references before it fails
+struct GoldenTolerance
+{
+    int channel = 8;                // Per-channel difference still counted as a match (rasterizer rounding)
+    double mismatched = 0.001;      // Fraction of pixels allowed to differ by more
+    double frameTime = 0.25;        // Allowed median frame time increase over the baseline, as a fraction
+};
+
+/*
+ * Regression check of rendered images and their cost against references in a
+ * directory:
+ *
+ *     <prefix>_<view>.ppm      the expected image of each view
+ *     <prefix>.perf            "<view> <median frame ms> <draw calls>" per line
+ *
+ * Check() compares a view with its reference image and baseline and records
+ * the outcome; with update set it writes them instead. Draw calls must match
+ * exactly; a frame time above the baseline by more than the tolerance is a
+ * performance regression. Report() prints every view and returns whether all
+ * of them passed. Images that fail are kept as <prefix>_<view>.actual.ppm.
+ */
+class GoldenSuite
+{
+public:
+    GoldenSuite(const std::string& directory, const std::string& prefix, bool update, const GoldenTolerance& tolerance = GoldenTolerance())
+        : mBase(directory + "/" + prefix), mUpdate(update), mTolerance(tolerance)
+    {
+        if (!mUpdate)
+            LoadBaseline();
+    }
+
+    void Check(const std::string& view, const Image& image, double frameTime, unsigned drawCalls)
+    {
+        Result result;
+        result.view = view;
+        result.frameTime = frameTime;
+        result.drawCalls = drawCalls;
+
+        std::string reference = mBase + "_" + view + ".ppm";
+        if (mUpdate)
+        {
+            result.difference.mismatched = 0.0;
+            result.difference.largest = 0;
+            result.imagePassed = WriteImage(reference, image);
+            result.perfPassed = true;
+            if (!result.imagePassed)
+                std::cout << "Could not write reference image " << reference << std::endl;
+            mResults.push_back(result);
+            return;
+        }
+
+        Image expected;
+        if (ReadImage(reference, expected))
+        {
+            result.difference = CompareImages(image, expected, mTolerance.channel);
+            result.imagePassed = result.difference.mismatched <= mTolerance.mismatched;
+        }
+        else
+            std::cout << "Missing or unreadable reference image " << reference << std::endl;
+        if (!result.imagePassed)
+            WriteImage(mBase + "_" + view + ".actual.ppm", image);
+
+        std::map<std::string, Baseline>::const_iterator baseline = mBaselines.find(view);
+        if (baseline != mBaselines.end())
+        {
+            result.hasBaseline = true;
+            result.baseline = baseline->second;
+            result.perfPassed = drawCalls == baseline->second.drawCalls && frameTime <= baseline->second.frameTime * (1.0 + mTolerance.frameTime);
+        }
+        mResults.push_back(result);
+    }
+
+    // Prints a line per view and, when updating, writes the baseline; true when everything passed
+    bool Report(std::ostream& out)
+    {
+        bool passed = true;
+        out << (mUpdate ? "Golden references written to " : "Golden check against ") << mBase << "_*" << std::endl;
+        out << std::fixed;
+        out << "  " << std::left << std::setw(12) << "view" << std::right << std::setw(10) << "off %" << std::setw(8) << "max"
+            << std::setw(11) << "frame ms" << std::setw(11) << "base ms" << std::setw(7) << "draws" << std::setw(7) << "base" << "  result" << std::endl;
+        for (const Result& result : mResults)
+        {
+            out << "  " << std::left << std::setw(12) << result.view << std::right << std::setprecision(3)
+                << std::setw(10) << result.difference.mismatched * 100.0 << std::setw(8) << result.difference.largest
+                << std::setw(11) << result.frameTime;
+            if (result.hasBaseline)
+                out << std::setw(11) << result.baseline.frameTime;
+            else
+                out << std::setw(11) << "-";
+            out << std::setw(7) << result.drawCalls;
+            if (result.hasBaseline)
+                out << std::setw(7) << result.baseline.drawCalls;
+            else
+                out << std::setw(7) << "-";
+
+            if (mUpdate)
+                out << "  written";
+            else if (!result.imagePassed)
+                out << "  IMAGE MISMATCH";
+            else if (!result.perfPassed)
+                out << "  PERF REGRESSION";
+            else if (!result.hasBaseline)
+                out << "  ok (no perf baseline)";
+            else
+                out << "  ok";
+            out << std::endl;
+            passed = passed && result.imagePassed && result.perfPassed;
+        }
+
+        if (mUpdate && !WriteBaseline())
+        {
+            out << "Could not write " << mBase << ".perf" << std::endl;
+            passed = false;
+        }
+        return passed;
+    }
+
+private:
+    struct Baseline
+    {
+        double frameTime = 0.0;
+        unsigned drawCalls = 0;
+    };
+
+    struct Result
+    {
+        std::string view;
+        ImageDifference difference;
+        bool imagePassed = false;
+        bool perfPassed = true;     // Views without a baseline only check the image
+        bool hasBaseline = false;
+        Baseline baseline;
+        double frameTime = 0.0;
+        unsigned drawCalls = 0;
+    };
+
+    std::string mBase;
+    bool mUpdate;
+    GoldenTolerance mTolerance;
+    std::map<std::string, Baseline> mBaselines;
+    std::vector<Result> mResults;
+
+    void LoadBaseline()
+    {
+        std::ifstream file(mBase + ".perf");
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            std::string view;
+            Baseline baseline;
+            if (fields >> view >> baseline.frameTime >> baseline.drawCalls)
+                mBaselines[view] = baseline;
+        }
+    }
+
+    bool WriteBaseline() const
+    {
+        std::ofstream file(mBase + ".perf");
+        file << std::fixed << std::setprecision(3);
+        for (const Result& result : mResults)
+            file << result.view << " " << result.frameTime << " " << result.drawCalls << "\n";
+        return (bool)file;
+    }
+};
+
+#endif
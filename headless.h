@@ -0,0 +1,204 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <iostream>         // cout, cerr
+#include <cstring>          // strstr
+#include <GL/glew.h>        // GLEW library
+
+#ifndef _WIN32
+#include <EGL/egl.h>        // EGL library (Mesa llvmpipe, NVIDIA, ...)
+#include <EGL/eglext.h>
+#endif
+
+/*
+ * Offscreen rendering without a display server.
+ *
+ * HeadlessContext creates an OpenGL core context through EGL, preferring a
+ * surfaceless display (EGL_MESA_platform_surfaceless) and falling back to a
+ * 1x1 pbuffer when the driver cannot make a context current without a surface.
+ * OffscreenTarget is the framebuffer object the scene is actually rendered into.
+ */
+namespace headless
+{
+    class HeadlessContext
+    {
+    public:
+        ~HeadlessContext()
+        {
+            Destroy();
+        }
+
+        // Creates the context and makes it current on the calling thread
+        bool Create(int majorVersion, int minorVersion)
+        {
+#ifdef _WIN32
+            std::cout << "Headless mode requires EGL, which is not available on this platform" << std::endl;
+            return false;
+#else
+            // Surfaceless platform first: works on Mesa without any X or Wayland server
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay)
+                mDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (mDisplay == EGL_NO_DISPLAY)
+                mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+            if (mDisplay == EGL_NO_DISPLAY || !eglInitialize(mDisplay, NULL, NULL))
+            {
+                std::cout << "Failed to initialize EGL display" << std::endl;
+                return false;
+            }
+
+            if (!eglBindAPI(EGL_OPENGL_API))
+            {
+                std::cout << "EGL implementation does not support desktop OpenGL" << std::endl;
+                return false;
+            }
+
+            const EGLint configAttribs[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8,
+                EGL_GREEN_SIZE, 8,
+                EGL_BLUE_SIZE, 8,
+                EGL_DEPTH_SIZE, 24,
+                EGL_NONE
+            };
+            EGLConfig config;
+            EGLint numConfigs = 0;
+            if (!eglChooseConfig(mDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+            {
+                std::cout << "No suitable EGL config found" << std::endl;
+                return false;
+            }
+
+            const EGLint contextAttribs[] = {
+                EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+                EGL_CONTEXT_MINOR_VERSION, minorVersion,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+            mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+            if (mContext == EGL_NO_CONTEXT)
+            {
+                std::cout << "Failed to create EGL context " << majorVersion << "." << minorVersion << std::endl;
+                return false;
+            }
+
+            // A pbuffer is only needed when the driver cannot bind a context without a surface
+            const char* extensions = eglQueryString(mDisplay, EGL_EXTENSIONS);
+            if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+            {
+                const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+                mSurface = eglCreatePbufferSurface(mDisplay, config, pbufferAttribs);
+                if (mSurface == EGL_NO_SURFACE)
+                {
+                    std::cout << "Failed to create EGL pbuffer surface" << std::endl;
+                    return false;
+                }
+            }
+
+            if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext))
+            {
+                std::cout << "Failed to make EGL context current" << std::endl;
+                return false;
+            }
+
+            // glewInit() also initializes GLX and fails without an X display,
+            // so only the core and extension entry points are loaded here
+            glewExperimental = GL_TRUE;
+            GLenum GlewInitResult = glewContextInit();
+            if (GLEW_OK != GlewInitResult)
+            {
+                std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+                return false;
+            }
+
+            return true;
+#endif
+        }
+
+        void Destroy()
+        {
+#ifndef _WIN32
+            if (mDisplay == EGL_NO_DISPLAY)
+                return;
+
+            eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (mSurface != EGL_NO_SURFACE)
+                eglDestroySurface(mDisplay, mSurface);
+            if (mContext != EGL_NO_CONTEXT)
+                eglDestroyContext(mDisplay, mContext);
+            eglTerminate(mDisplay);
+
+            mDisplay = EGL_NO_DISPLAY;
+            mContext = EGL_NO_CONTEXT;
+            mSurface = EGL_NO_SURFACE;
+#endif
+        }
+
+    private:
+#ifndef _WIN32
+        EGLDisplay mDisplay = EGL_NO_DISPLAY;
+        EGLContext mContext = EGL_NO_CONTEXT;
+        EGLSurface mSurface = EGL_NO_SURFACE;
+#endif
+    };
+
+    // Color + depth framebuffer object used as the render target in headless mode
+    class OffscreenTarget
+    {
+    public:
+        GLuint fbo = 0;
+        GLuint colorBuffer = 0;
+        GLuint depthBuffer = 0;
+        int width = 0;
+        int height = 0;
+
+        bool Create(int targetWidth, int targetHeight)
+        {
+            width = targetWidth;
+            height = targetHeight;
+
+            glGenRenderbuffers(1, &colorBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+            glGenRenderbuffers(1, &depthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (status != GL_FRAMEBUFFER_COMPLETE)
+            {
+                std::cout << "Offscreen framebuffer is incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Binds the framebuffer and sets the viewport to cover it
+        void Bind() const
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, width, height);
+        }
+
+        void Destroy()
+        {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            fbo = colorBuffer = depthBuffer = 0;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef INPUT_RECORDING_H
+#define INPUT_RECORDING_H
+
+#include <iostream>         // cout
+#include <cstdio>           // fopen, fread, fwrite
+#include <cstdint>
+#include <cstring>          // memcmp
+#include <algorithm>        // min
+#include <vector>
+
+const char INPUT_RECORDING_MAGIC[4] = { 'I', 'N', 'P', 'R' };
+const uint32_t INPUT_RECORDING_VERSION = 1;
+
+// Something that happened between two frames; only the fields of its type are stored
+enum class InputEventType : uint8_t { MouseMove = 0, Scroll = 1, KeyPress = 2 };
+
+struct InputEvent
+{
+    InputEventType type = InputEventType::MouseMove;
+    float x = 0.0f;             // MouseMove: x offset
+    float y = 0.0f;             // MouseMove: y offset, Scroll: y offset
+    int32_t key = 0;            // KeyPress: GLFW key code
+
+    static InputEvent MouseMove(float xoffset, float yoffset)
+    {
+        InputEvent event;
+        event.type = InputEventType::MouseMove;
+        event.x = xoffset;
+        event.y = yoffset;
+        return event;
+    }
+
+    static InputEvent Scroll(float yoffset)
+    {
+        InputEvent event;
+        event.type = InputEventType::Scroll;
+        event.y = yoffset;
+        return event;
+    }
+
+    static InputEvent KeyPress(int key)
+    {
+        InputEvent event;
+        event.type = InputEventType::KeyPress;
+        event.key = key;
+        return event;
+    }
+};
+
+// The input of one frame: the events handled while it was sampled, in order, then the keys held
+struct InputFrame
+{
+    double delta = 0.0;         // Seconds since the previous frame sampled its input
+    uint8_t heldKeys = 0;       // One bit per held movement key, as the application numbers them
+    std::vector<InputEvent> events;
+};
+
+/*
+ * Writes the input of every frame to a file as it is sampled:
+ *
+ *     header   "INPR", version (uint32), simulation tick rate (double)
+ *     frame    delta (double), held keys (uint8), event count (uint16), events
+ *     event    type (uint8), then x and y (float) for a mouse move,
+ *              y (float) for a scroll, key (int32) for a key press
+ *
+ * in the machine's byte order, about a dozen bytes per frame. Events carry
+ * the time of the frame they were handled in; played back frame by frame
+ * with the same deltas, they drive a fixed-step simulation through exactly
+ * the same ticks.
+ */
+class InputRecorder
+{
+public:
+    ~InputRecorder()
+    {
+        Finish();
+    }
+
+    bool Create(const char* filename, double tickRate)
+    {
+        Finish();
+        mFile = fopen(filename, "wb");
+        if (!mFile)
+        {
+            std::cout << "Could not create input recording " << filename << std::endl;
+            return false;
+        }
+        mFrames = 0;
+        mEvents.clear();
+        mFailed = !(Write(INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC)) && Write(&INPUT_RECORDING_VERSION, sizeof(INPUT_RECORDING_VERSION))
+            && Write(&tickRate, sizeof(tickRate)));
+        return !mFailed;
+    }
+
+    bool Recording() const
+    {
+        return mFile != nullptr;
+    }
+
+    // Adds an event to the frame being sampled
+    void Add(const InputEvent& event)
+    {
+        if (mFile)
+            mEvents.push_back(event);
+    }
+
+    // Writes the frame being sampled, with the events added since the last call
+    void EndFrame(double delta, uint8_t heldKeys)
+    {
+        if (!mFile)
+            return;
+
+        uint16_t eventCount = (uint16_t)std::min<size_t>(mEvents.size(), UINT16_MAX);
+        bool written = Write(&delta, sizeof(delta)) && Write(&heldKeys, sizeof(heldKeys)) && Write(&eventCount, sizeof(eventCount));
+        for (uint16_t i = 0; i < eventCount && written; ++i)
+        {
+            const InputEvent& event = mEvents[i];
+            written = Write(&event.type, sizeof(event.type));
+            if (event.type == InputEventType::MouseMove)
+                written = written && Write(&event.x, sizeof(event.x)) && Write(&event.y, sizeof(event.y));
+            else if (event.type == InputEventType::Scroll)
+                written = written && Write(&event.y, sizeof(event.y));
+            else
+                written = written && Write(&event.key, sizeof(event.key));
+        }
+        mFailed = mFailed || !written;
+        mEvents.clear();
+        ++mFrames;
+    }
+
+    // Closes the file; false when any of it could not be written
+    bool Finish()
+    {
+        if (!mFile)
+            return true;
+        bool finished = fclose(mFile) == 0 && !mFailed;
+        mFile = nullptr;
+        if (!finished)
+            std::cout << "Input recording is incomplete, the file could not be written" << std::endl;
+        return finished;
+    }
+
+    unsigned FrameCount() const
+    {
+        return mFrames;
+    }
+
+private:
+    FILE* mFile = nullptr;
+    bool mFailed = false;
+    unsigned mFrames = 0;
+    std::vector<InputEvent> mEvents;
+
+    bool Write(const void* data, size_t size)
+    {
+        return fwrite(data, size, 1, mFile) == 1;
+    }
+};
+
+// A file written by InputRecorder, read whole so playback never waits on the disk
+class InputReplay
+{
+public:
+    bool Load(const char* filename)
+    {
+        mFrames.clear();
+        FILE* file = fopen(filename, "rb");
+        if (!file)
+        {
+            std::cout << "Could not open input recording " << filename << std::endl;
+            return false;
+        }
+
+        char magic[4];
+        uint32_t version = 0;
+        bool loaded = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, INPUT_RECORDING_MAGIC, sizeof(magic)) == 0
+            && fread(&version, sizeof(version), 1, file) == 1 && version == INPUT_RECORDING_VERSION
+            && fread(&mTickRate, sizeof(mTickRate), 1, file) == 1 && mTickRate > 0.0;
+
+        InputFrame frame;
+        while (loaded && fread(&frame.delta, sizeof(frame.delta), 1, file) == 1)
+        {
+            uint16_t eventCount = 0;
+            loaded = fread(&frame.heldKeys, sizeof(frame.heldKeys), 1, file) == 1 && fread(&eventCount, sizeof(eventCount), 1, file) == 1;
+            frame.events.resize(loaded ? eventCount : 0);
+            for (InputEvent& event : frame.events)
+            {
+                event = InputEvent();
+                loaded = loaded && fread(&event.type, sizeof(event.type), 1, file) == 1;
+                if (!loaded)
+                    break;
+                if (event.type == InputEventType::MouseMove)
+                    loaded = fread(&event.x, sizeof(event.x), 1, file) == 1 && fread(&event.y, sizeof(event.y), 1, file) == 1;
+                else if (event.type == InputEventType::Scroll)
+                    loaded = fread(&event.y, sizeof(event.y), 1, file) == 1;
+                else if (event.type == InputEventType::KeyPress)
+                    loaded = fread(&event.key, sizeof(event.key), 1, file) == 1;
+                else
+                    loaded = false;
+            }
+            if (loaded)
+                mFrames.push_back(frame);
+        }
+        fclose(file);
+
+        if (!loaded)
+        {
+            std::cout << "Input recording " << filename << " is not valid" << std::endl;
+            mFrames.clear();
+        }
+        mLoaded = loaded;
+        return loaded;
+    }
+
+    bool Loaded() const
+    {
+        return mLoaded;
+    }
+
+    // Ticks per second of the simulation the input was recorded with
+    double TickRate() const
+    {
+        return mTickRate;
+    }
+
+    size_t FrameCount() const
+    {
+        return mFrames.size();
+    }
+
+    const InputFrame& Frame(size_t index) const
+    {
+        return mFrames[index];
+    }
+
+private:
+    bool mLoaded = false;
+    double mTickRate = 60.0;
+    std::vector<InputFrame> mFrames;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef JOB_BENCHMARK_H
+#define JOB_BENCHMARK_H
+
+#include <iostream>         // cout
+#include <iomanip>          // setw, setprecision
+#include <cmath>            // sin, cos
+#include <vector>
+#include <algorithm>        // sort, min, max
+#include <random>
+#include <chrono>
+#include <thread>           // hardware_concurrency
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "job_system.h"     // JobSystem
+#include "culling.h"        // Bounds, Frustum
+#include "command_list.h"   // DrawItem, CommandList
+
+/*
+ * CPU-only benchmark of the job system on a synthetic scene: every frame,
+ * each object's transform is advanced, its world bounds recomputed and culled
+ * against a moving camera, and the survivors are recorded and sorted into one
+ * CommandList per range, the same stages Project2 runs per partition.
+ *
+ * The frame is run with 1, 2, 4, ... threads up to the hardware count, and
+ * the median frame time and speedup over one thread are printed for each.
+ * No GL context is needed.
+ */
+class JobBenchmark
+{
+public:
+    JobBenchmark(unsigned objectCount, unsigned frames)
+        : mFrames(frames)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+        std::uniform_real_distribution<float> spin(-2.0f, 2.0f);
+
+        mObjects.resize(objectCount);
+        for (unsigned i = 0; i < objectCount; ++i)
+        {
+            Object& object = mObjects[i];
+            object.position = glm::vec3(position(random), position(random) * 0.1f, position(random));
+            object.spin = spin(random);
+            object.item.program = 1 + i % 3;
+            object.item.textures[0] = 1 + i % 7;
+            object.item.vao = 1;
+            object.item.baseVertex = (GLint)(i % 16) * 1000;
+            object.item.indexCount = 36;
+        }
+        mBounds.resize(objectCount);
+    }
+
+    void Run(std::ostream& out)
+    {
+        out << "Job benchmark: " << mObjects.size() << " objects, " << mFrames << " frames per thread count" << std::endl;
+        out << std::fixed << std::setprecision(3);
+        out << std::setw(8) << "threads" << std::setw(12) << "p50 ms" << std::setw(10) << "speedup" << std::setw(10) << "visible" << std::endl;
+
+        unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+        double baseline = 0.0;
+        for (unsigned threads = 1; ; threads = std::min(threads * 2, hardware))
+        {
+            size_t visible = 0;
+            double median = Measure(threads, visible);
+            if (threads == 1)
+                baseline = median;
+            out << std::setw(8) << threads << std::setw(12) << median << std::setw(10) << std::setprecision(2)
+                << baseline / median << std::setw(10) << visible << std::setprecision(3) << std::endl;
+            if (threads == hardware)
+                break;
+        }
+    }
+
+private:
+    static const unsigned GRAIN = 1024;    // Objects per job
+
+    struct Object
+    {
+        glm::vec3 position;
+        float spin;
+        DrawItem item;
+    };
+
+    unsigned mFrames;
+    std::vector<Object> mObjects;
+    std::vector<Bounds> mBounds;
+
+    // Median time of one frame with the given number of threads
+    double Measure(unsigned threads, size_t& visible)
+    {
+        JobSystem jobs;
+        jobs.Create(threads);
+
+        unsigned rangeCount = ((unsigned)mObjects.size() + GRAIN - 1) / GRAIN;
+        std::vector<CommandList> lists(rangeCount);
+        const Bounds unitBox = Bounds::FromMinMax(glm::vec3(-0.5f), glm::vec3(0.5f));
+
+        std::vector<double> times;
+        for (unsigned frame = 0; frame < mFrames; ++frame)
+        {
+            float time = frame * (1.0f / 60.0f);
+            glm::vec3 eye(std::cos(time * 0.5f) * 50.0f, 10.0f, std::sin(time * 0.5f) * 50.0f);
+            glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+            Frustum frustum(projection * view);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            jobs.ParallelFor((unsigned)mObjects.size(), GRAIN, [&](unsigned first, unsigned last)
+            {
+                CommandList& list = lists[first / GRAIN];
+                list.Clear();
+                for (unsigned i = first; i < last; ++i)
+                {
+                    Object& object = mObjects[i];
+                    object.item.model = glm::rotate(glm::translate(glm::mat4(1.0f), object.position), object.spin * time, glm::vec3(0.0f, 1.0f, 0.0f));
+                    mBounds[i] = unitBox.Transform(object.item.model);
+                    if (!frustum.Visible(mBounds[i]))
+                        continue;
+                    float viewDepth = -(view * object.item.model[3]).z;
+                    list.Push(object.item, viewDepth, 300.0f);
+                }
+                list.Sort();
+            });
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            times.push_back(elapsed.count());
+        }
+
+        visible = 0;
+        for (const CommandList& list : lists)
+            visible += list.Size();
+
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+};
+
+#endif
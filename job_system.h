@@ -0,0 +1,282 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <vector>
+#include <algorithm>        // min, max
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+/*
+ * Counts the unfinished jobs of a group. Jobs scheduled with a counter
+ * increment it and decrement it when they return; JobSystem::Wait() blocks
+ * until it reaches zero, and jobs scheduled *after* a counter start only
+ * once it has. A counter must outlive the jobs that refer to it.
+ */
+class JobCounter
+{
+public:
+    bool Done() const
+    {
+        return mPending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    struct Continuation
+    {
+        std::function<void()> function;
+        JobCounter* counter;
+    };
+
+    std::atomic<int> mPending{ 0 };
+    std::mutex mMutex;
+    std::vector<Continuation> mContinuations;     // Jobs waiting for this counter to reach zero
+};
+
+/*
+ * Work-stealing job scheduler for the engine's CPU-side stages.
+ *
+ *     JobCounter loaded;
+ *     jobs.Schedule([&]() { Decode(image); }, loaded);
+ *     jobs.ScheduleAfter(loaded, [&]() { Bake(image); }, baked);
+ *     jobs.ParallelFor(objectCount, 256, [&](unsigned first, unsigned last) { Cull(first, last); });
+ *     jobs.Wait(baked);
+ *
+ * Every thread has its own deque. A thread pushes and pops jobs at the back
+ * of its own deque (newest first, while their data is still in cache) and,
+ * when that runs dry, steals the oldest job from the front of another's.
+ * Each deque has its own lock, so threads only contend when stealing.
+ * Threads that are not workers (the one owning the GL context, say) share
+ * deque 0, and Wait() runs jobs instead of blocking, so the waiting thread
+ * is never idle while its own work is pending.
+ */
+class JobSystem
+{
+public:
+    ~JobSystem()
+    {
+        Destroy();
+    }
+
+    // Starts threadCount - 1 workers, the calling thread being the last one; 0 matches the hardware
+    void Create(unsigned threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        mStop = false;
+        mQueued = 0;
+        mQueues.clear();
+        for (unsigned i = 0; i < threadCount; ++i)
+            mQueues.emplace_back(new Queue());
+        for (unsigned i = 1; i < threadCount; ++i)
+            mWorkers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+
+    // Stops the workers; jobs that have not started are dropped
+    void Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mStop = true;
+        }
+        mWorkAvailable.notify_all();
+        for (std::thread& worker : mWorkers)
+            worker.join();
+        mWorkers.clear();
+        mQueues.clear();
+    }
+
+    // Threads that run jobs, the one calling Wait() included
+    unsigned ThreadCount() const
+    {
+        return (unsigned)mWorkers.size() + 1;
+    }
+
+    void Schedule(std::function<void()> function, JobCounter& counter)
+    {
+        counter.mPending.fetch_add(1, std::memory_order_relaxed);
+        Push(Job{ std::move(function), &counter });
+    }
+
+    // Schedules function to run once dependency reaches zero
+    void ScheduleAfter(JobCounter& dependency, std::function<void()> function, JobCounter& counter)
+    {
+        counter.mPending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(dependency.mMutex);
+            if (!dependency.Done())
+            {
+                dependency.mContinuations.push_back(JobCounter::Continuation{ std::move(function), &counter });
+                return;
+            }
+        }
+        Push(Job{ std::move(function), &counter });
+    }
+
+    // Runs jobs on the calling thread until the counter reaches zero
+    void Wait(JobCounter& counter)
+    {
+        while (!counter.Done())
+        {
+            if (!RunOne(CurrentQueue()))
+                std::this_thread::yield();
+        }
+
+        // The last job's Finish() may still hold the lock; the counter can go away once it is released
+        std::lock_guard<std::mutex> lock(counter.mMutex);
+    }
+
+    // Calls body(first, last) over [0, count) in ranges of about grain items; returns when all are done
+    void ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& body)
+    {
+        grain = std::max(1u, grain);
+        if (count <= grain || mQueues.size() <= 1)
+        {
+            if (count > 0)
+                body(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        for (unsigned first = grain; first < count; first += grain)
+        {
+            unsigned last = std::min(count, first + grain);
+            Schedule([&body, first, last]() { body(first, last); }, counter);
+        }
+        body(0, grain);     // The first range runs right here
+        Wait(counter);
+    }
+
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        JobCounter* counter;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mWorkers;
+    std::atomic<int> mQueued{ 0 };          // Jobs sitting in any deque
+
+    std::mutex mSleepMutex;
+    std::condition_variable mWorkAvailable;
+    bool mStop = false;
+
+    // Deque of the calling thread; 0 for threads that are not workers of this system
+    size_t CurrentQueue() const
+    {
+        return WorkerSystem() == this ? WorkerIndex() : 0;
+    }
+
+    static const JobSystem*& WorkerSystem()
+    {
+        thread_local const JobSystem* system = nullptr;
+        return system;
+    }
+
+    static size_t& WorkerIndex()
+    {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    void Push(Job job)
+    {
+        Queue& queue = *mQueues[CurrentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+        mQueued.fetch_add(1, std::memory_order_release);
+        {
+            // Taking the lock orders this with a worker checking mQueued before it sleeps
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+        }
+        mWorkAvailable.notify_one();
+    }
+
+    // Takes the newest job of the own deque, or the oldest of another; false when all are empty
+    bool Pop(size_t own, Job& job)
+    {
+        if (mQueued.load(std::memory_order_acquire) == 0)
+            return false;
+        for (size_t i = 0; i < mQueues.size(); ++i)
+        {
+            size_t index = (own + i) % mQueues.size();
+            Queue& queue = *mQueues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty())
+                continue;
+            if (index == own)
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            }
+            else
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            mQueued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool RunOne(size_t own)
+    {
+        Job job;
+        if (!Pop(own, job))
+            return false;
+
+        job.function();
+        Finish(*job.counter);
+        return true;
+    }
+
+    // Counts a job as done; the last one of a group releases the jobs scheduled after it
+    void Finish(JobCounter& counter)
+    {
+        // Decremented under the lock, so ScheduleAfter() either sees the counter done or leaves its job here
+        std::vector<JobCounter::Continuation> continuations;
+        {
+            std::lock_guard<std::mutex> lock(counter.mMutex);
+            if (counter.mPending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            continuations.swap(counter.mContinuations);
+        }
+        for (JobCounter::Continuation& continuation : continuations)
+            Push(Job{ std::move(continuation.function), continuation.counter });
+    }
+
+    void WorkerLoop(size_t index)
+    {
+        WorkerSystem() = this;
+        WorkerIndex() = index;
+        for (;;)
+        {
+            if (RunOne(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mWorkAvailable.wait(lock, [this]() { return mStop || mQueued.load(std::memory_order_acquire) > 0; });
+            if (mStop)
+                return;
+        }
+    }
+};
+
+#endif
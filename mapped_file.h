@@ -0,0 +1,104 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>          // size_t
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>        // CreateFileMapping, MapViewOfFile
+#else
+#include <fcntl.h>          // open
+#include <unistd.h>         // close
+#include <sys/mman.h>       // mmap, madvise
+#include <sys/stat.h>       // fstat
+#endif
+
+// A file mapped read-only into memory; pages are read in as they are touched
+class MappedFile
+{
+public:
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    bool Open(const char* filename)
+    {
+        Close();
+#ifdef _WIN32
+        mFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        LARGE_INTEGER size;
+        if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+        mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        mData = mMapping ? (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        mSize = (size_t)size.QuadPart;
+#else
+        int file = open(filename, O_RDONLY);
+        struct stat status;
+        if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0)
+        {
+            if (file >= 0)
+                close(file);
+            return false;
+        }
+        void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);    // The mapping keeps the file open
+        if (data == MAP_FAILED)
+            return false;
+        madvise(data, (size_t)status.st_size, MADV_SEQUENTIAL);
+        mData = (const unsigned char*)data;
+        mSize = (size_t)status.st_size;
+#endif
+        if (!mData)
+            Close();
+        return mData != nullptr;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (mData)
+            UnmapViewOfFile(mData);
+        if (mMapping)
+            CloseHandle(mMapping);
+        if (mFile != INVALID_HANDLE_VALUE)
+            CloseHandle(mFile);
+        mMapping = NULL;
+        mFile = INVALID_HANDLE_VALUE;
+#else
+        if (mData)
+            munmap((void*)mData, mSize);
+#endif
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    const unsigned char* Data() const
+    {
+        return mData;
+    }
+
+    size_t Size() const
+    {
+        return mSize;
+    }
+
+private:
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = NULL;
+#endif
+};
+
+#endif
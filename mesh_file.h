@@ -0,0 +1,318 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <iostream>         // cout
+#include <cstdio>           // fopen, fwrite
+#include <cstdint>
+#include <cstring>          // memcmp, memcpy
+#include <string>
+#include <vector>
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+#include "vertex_layout.h"  // PackedLayout
+#include "primitives.h"     // MeshData
+#include "culling.h"        // Bounds
+
+const char MESH_FILE_MAGIC[4] = { 'M', 'E', 'S', 'H' };
+const uint32_t MESH_FILE_VERSION = 2;
+const uint32_t MESH_FILE_ALIGNMENT = 64;    // Of both data streams, from the start of the file
+
+/*
+ * Binary mesh container, laid out so a mapped file can be handed to GL as is:
+ *
+ *     MeshFileHeader
+ *     MeshFileAttribute[attributeCount]   the vertex layout (a PackedLayout)
+ *     MeshFileLod[lodCount]               most detailed first
+ *     vertex stream                       every level's packed vertices, back to back
+ *     index stream                        every level's indices, relative to its first vertex
+ *
+ * Both streams start on a MESH_FILE_ALIGNMENT boundary. Indices are GLushort
+ * when every level has at most 65536 vertices and GLuint otherwise, the two
+ * index types the mesh arena takes. All values are in the byte order of the
+ * machine that wrote the file.
+ */
+struct MeshFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t attributeCount;
+    uint32_t lodCount;
+    uint32_t indexBytes;                // 2 or 4, for every level
+    float boundsMin[3];                 // Over every level
+    float boundsMax[3];
+    uint64_t vertexOffset;              // Byte ranges of the streams within the file
+    uint64_t vertexSize;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+};
+
+struct MeshFileAttribute
+{
+    uint32_t location;
+    uint32_t semantic;                  // VertexSemantic
+    uint32_t format;                    // AttribFormat
+    uint32_t offset;
+};
+
+struct MeshFileLod
+{
+    uint32_t firstVertex;               // Into the vertex stream, in vertices
+    uint32_t vertexCount;
+    uint32_t firstIndex;                // Into the index stream, in indices
+    uint32_t indexCount;
+    float minScreenSize;                // As in the scene file's lod lines
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t reserved;
+};
+
+// One level to write: its vertices, its indices and the screen size it starts at
+struct MeshFileLevel
+{
+    const std::vector<SourceVertex>* vertices;
+    const std::vector<uint32_t>* indices;
+    float minScreenSize;
+};
+
+
+/*
+ * A mesh file, mapped and checked but otherwise untouched: Vertices() and
+ * Indices() point into the mapping, so a level whose layout matches the
+ * arena's goes from the page cache to the driver without being parsed or
+ * copied on the way.
+ */
+class MeshFile
+{
+public:
+    bool Open(const char* filename)
+    {
+        if (!mFile.Open(filename))
+        {
+            std::cout << "Could not map mesh file " << filename << std::endl;
+            return false;
+        }
+        if (!Validate())
+        {
+            std::cout << "Mesh file " << filename << " is not valid" << std::endl;
+            mFile.Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        mFile.Close();
+    }
+
+    PackedLayout Layout() const
+    {
+        PackedLayout layout;
+        layout.stride = Header().vertexStride;
+        const MeshFileAttribute* attributes = (const MeshFileAttribute*)(mFile.Data() + sizeof(MeshFileHeader));
+        for (uint32_t i = 0; i < Header().attributeCount; ++i)
+            layout.attributes.push_back(AttribDesc{ attributes[i].location, (VertexSemantic)attributes[i].semantic, (AttribFormat)attributes[i].format, attributes[i].offset });
+        return layout;
+    }
+
+    uint32_t LodCount() const
+    {
+        return Header().lodCount;
+    }
+
+    const MeshFileLod& Lod(uint32_t level) const
+    {
+        return Lods()[level];
+    }
+
+    Bounds LodBounds(uint32_t level) const
+    {
+        const MeshFileLod& lod = Lod(level);
+        return Bounds::FromMinMax(glm::vec3(lod.boundsMin[0], lod.boundsMin[1], lod.boundsMin[2]), glm::vec3(lod.boundsMax[0], lod.boundsMax[1], lod.boundsMax[2]));
+    }
+
+    const void* Vertices(uint32_t level) const
+    {
+        return mFile.Data() + Header().vertexOffset + (size_t)Lod(level).firstVertex * Header().vertexStride;
+    }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for every level
+    GLenum IndexType() const
+    {
+        return Header().indexBytes == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    }
+
+    const void* Indices(uint32_t level) const
+    {
+        return mFile.Data() + Header().indexOffset + (size_t)Lod(level).firstIndex * Header().indexBytes;
+    }
+
+private:
+    MappedFile mFile;
+
+    const MeshFileHeader& Header() const
+    {
+        return *(const MeshFileHeader*)mFile.Data();
+    }
+
+    const MeshFileLod* Lods() const
+    {
+        return (const MeshFileLod*)(mFile.Data() + sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * Header().attributeCount);
+    }
+
+    // Every range the accessors hand out has to lie inside the file, and every index inside its level
+    bool Validate() const
+    {
+        if (mFile.Size() < sizeof(MeshFileHeader))
+            return false;
+        const MeshFileHeader& header = Header();
+        if (memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_FILE_VERSION
+            || header.vertexStride == 0 || header.attributeCount > 16 || header.lodCount == 0 || header.lodCount > 64
+            || (header.indexBytes != 2 && header.indexBytes != 4))
+            return false;
+
+        uint64_t tables = sizeof(MeshFileHeader) + sizeof(MeshFileAttribute) * (uint64_t)header.attributeCount + sizeof(MeshFileLod) * (uint64_t)header.lodCount;
+        // Ranges are checked by subtraction, so a crafted size cannot wrap the sum around past the check
+        if (tables > header.vertexOffset || header.vertexOffset % MESH_FILE_ALIGNMENT != 0 || header.indexOffset % MESH_FILE_ALIGNMENT != 0
+            || header.vertexOffset > header.indexOffset || header.vertexSize > header.indexOffset - header.vertexOffset
+            || header.indexOffset > mFile.Size() || header.indexSize > mFile.Size() - header.indexOffset)
+            return false;
+
+        PackedLayout layout = Layout();
+        for (const AttribDesc& attribute : layout.attributes)
+        {
+            if ((uint32_t)attribute.format > (uint32_t)AttribFormat::SNorm10_10_10_2 || (uint32_t)attribute.semantic > (uint32_t)VertexSemantic::Normal
+                || attribute.offset > header.vertexStride || AttribFormatSize(attribute.format) > header.vertexStride - attribute.offset)
+                return false;
+        }
+
+        uint64_t vertexCount = header.vertexSize / header.vertexStride;
+        uint64_t indexCount = header.indexSize / header.indexBytes;
+        uint64_t maxVertices = header.indexBytes == 2 ? 65536 : INT32_MAX;
+        for (uint32_t i = 0; i < header.lodCount; ++i)
+        {
+            const MeshFileLod& lod = Lods()[i];
+            if (lod.vertexCount == 0 || lod.vertexCount > maxVertices || (uint64_t)lod.firstVertex + lod.vertexCount > vertexCount
+                || lod.indexCount == 0 || (uint64_t)lod.firstIndex + lod.indexCount > indexCount)
+                return false;
+
+            // An index past its level's vertices would read another level's, or another mesh's, out of the arena
+            bool inside = header.indexBytes == 2 ? IndicesBelow((const GLushort*)Indices(i), lod.indexCount, lod.vertexCount)
+                : IndicesBelow((const GLuint*)Indices(i), lod.indexCount, lod.vertexCount);
+            if (!inside)
+                return false;
+        }
+        return true;
+    }
+
+    template <typename Index>
+    static bool IndicesBelow(const Index* indices, uint32_t count, uint32_t limit)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            if (indices[i] >= limit)
+                return false;
+        return true;
+    }
+};
+
+
+// Writes levels in the given layout, with 16-bit indices when every level allows them; false when the file cannot be written
+inline bool WriteMeshFile(const char* filename, const PackedLayout& layout, const std::vector<MeshFileLevel>& levels)
+{
+    MeshFileHeader header = {};
+    memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+    header.version = MESH_FILE_VERSION;
+    header.vertexStride = layout.stride;
+    header.attributeCount = (uint32_t)layout.attributes.size();
+    header.lodCount = (uint32_t)levels.size();
+    header.indexBytes = sizeof(GLushort);
+    for (const MeshFileLevel& level : levels)
+        if (level.vertices->size() > 65536)
+            header.indexBytes = sizeof(GLuint);
+
+    std::vector<MeshFileAttribute> attributes;
+    for (const AttribDesc& attribute : layout.attributes)
+        attributes.push_back(MeshFileAttribute{ attribute.location, (uint32_t)attribute.semantic, (uint32_t)attribute.format, attribute.offset });
+
+    // Pack every level into the two streams
+    std::vector<MeshFileLod> lods;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    Bounds all;
+    for (const MeshFileLevel& level : levels)
+    {
+        const std::vector<SourceVertex>& levelVertices = *level.vertices;
+        if (levelVertices.empty() || level.indices->empty() || levelVertices.size() > INT32_MAX)
+        {
+            std::cout << "A level needs vertices and indices, this one has " << levelVertices.size() << " vertices and " << level.indices->size() << " indices" << std::endl;
+            return false;
+        }
+
+        Bounds bounds;
+        for (const SourceVertex& vertex : levelVertices)
+            bounds.Add(vertex.position);
+        all.Add(bounds);
+
+        MeshFileLod lod = {};
+        lod.firstVertex = (uint32_t)(vertices.size() / layout.stride);
+        lod.vertexCount = (uint32_t)levelVertices.size();
+        lod.firstIndex = (uint32_t)(indices.size() / header.indexBytes);
+        lod.indexCount = (uint32_t)level.indices->size();
+        lod.minScreenSize = level.minScreenSize;
+        glm::vec3 min = bounds.Min(), max = bounds.Max();
+        memcpy(lod.boundsMin, &min[0], sizeof(lod.boundsMin));
+        memcpy(lod.boundsMax, &max[0], sizeof(lod.boundsMax));
+        lods.push_back(lod);
+
+        layout.Pack(levelVertices.data(), levelVertices.size(), vertices);
+        size_t first = indices.size();
+        indices.resize(first + level.indices->size() * header.indexBytes);
+        if (header.indexBytes == sizeof(GLuint))
+            memcpy(indices.data() + first, level.indices->data(), level.indices->size() * sizeof(GLuint));
+        else
+        {
+            GLushort* narrow = (GLushort*)(indices.data() + first);
+            for (size_t i = 0; i < level.indices->size(); ++i)
+                narrow[i] = (GLushort)(*level.indices)[i];
+        }
+    }
+    glm::vec3 min = all.Min(), max = all.Max();
+    memcpy(header.boundsMin, &min[0], sizeof(header.boundsMin));
+    memcpy(header.boundsMax, &max[0], sizeof(header.boundsMax));
+
+    auto align = [](uint64_t offset) { return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT; };
+    uint64_t tables = sizeof(header) + sizeof(MeshFileAttribute) * attributes.size() + sizeof(MeshFileLod) * lods.size();
+    header.vertexOffset = align(tables);
+    header.vertexSize = vertices.size();
+    header.indexOffset = align(header.vertexOffset + header.vertexSize);
+    header.indexSize = indices.size();
+
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        std::cout << "Could not create mesh file " << filename << std::endl;
+        return false;
+    }
+    const unsigned char zeros[MESH_FILE_ALIGNMENT] = {};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(attributes.data(), sizeof(MeshFileAttribute), attributes.size(), file) == attributes.size()
+        && fwrite(lods.data(), sizeof(MeshFileLod), lods.size(), file) == lods.size()
+        && fwrite(zeros, 1, header.vertexOffset - tables, file) == header.vertexOffset - tables
+        && fwrite(vertices.data(), 1, vertices.size(), file) == vertices.size()
+        && fwrite(zeros, 1, header.indexOffset - header.vertexOffset - header.vertexSize, file) == header.indexOffset - header.vertexOffset - header.vertexSize
+        && fwrite(indices.data(), 1, indices.size(), file) == indices.size();
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        std::cout << "Could not write mesh file " << filename << std::endl;
+        remove(filename);
+    }
+    return written;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+#include <iostream>         // cout
+#include <cstdint>
+#include <cstring>          // memcmp
+#include <vector>
+#include <unordered_map>
+#include <GL/glew.h>        // GLEW library
+
+#include "culling.h"        // Bounds
+
+// Range of the shared vertex/index arena occupied by one mesh
+struct GLMesh
+{
+    GLint baseVertex = 0;   // Added to every index when drawing
+    GLuint firstIndex = 0;  // Offset into the index buffer, in indices of indexType
+    GLuint nIndices = 0;    // Number of indices of the mesh
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    Bounds bounds;          // Model space, filled in by whoever creates the mesh
+};
+
+/*
+ * Owns one vertex buffer, one index buffer and one VAO that every mesh is
+ * suballocated from, so switching meshes never switches buffers. Meshes of up
+ * to 65536 vertices store GLushort indices; larger ones store GLuint indices
+ * in the same buffer, 4-byte aligned, so both kinds draw from the same VAO.
+ *
+ * Incoming vertex and index data are hashed; a block identical to one that is
+ * already resident is not uploaded again. Vertex and index blocks are
+ * deduplicated separately, so meshes with different vertices but the same
+ * topology (e.g. two boxes of different extents) share their indices. A copy
+ * of every deduplicated block stays in system memory, so a hash match is
+ * confirmed there instead of by reading the buffer back from the GPU. Meshes
+ * that are known to be unique, like the levels of a mapped mesh file, are
+ * added without deduplication: they are neither hashed nor copied, only
+ * uploaded from wherever they are.
+ *
+ * The caller configures the vertex attributes on Vao() once after Create().
+ */
+class MeshRegistry
+{
+public:
+    // maxIndices counts GLushort indices; a GLuint index takes the room of two
+    bool Create(GLuint vertexStride, GLuint maxVertices, GLuint maxIndices)
+    {
+        mVertexStride = vertexStride;
+        mMaxVertices = maxVertices;
+        mMaxIndices = maxIndices;
+
+        glGenVertexArrays(1, &mVao);
+        glBindVertexArray(mVao);
+
+        // Immutable storage: the arena never moves, so attribute setup stays valid
+        glGenBuffers(1, &mVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+        glBufferStorage(GL_ARRAY_BUFFER, (GLsizeiptr)vertexStride * maxVertices, NULL, GL_DYNAMIC_STORAGE_BIT);
+
+        glGenBuffers(1, &mEbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * maxIndices, NULL, GL_DYNAMIC_STORAGE_BIT);
+
+        // Leave the VAO and vertex buffer bound for the caller's glVertexAttribPointer calls
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    void Destroy()
+    {
+        glDeleteVertexArrays(1, &mVao);
+        glDeleteBuffers(1, &mVbo);
+        glDeleteBuffers(1, &mEbo);
+        mVao = mVbo = mEbo = 0;
+        mVertexBlocks.clear();
+        mIndexBlocks.clear();
+        mVertexShadow = std::vector<unsigned char>();
+        mIndexShadow = std::vector<unsigned char>();
+        mVertexCount = mIndexCount = mDuplicates = 0;
+    }
+
+    // Uploads a mesh (or, when deduplicating, finds an identical one) and returns its range in the arena
+    bool Add(const void* vertices, GLuint vertexCount, const GLushort* indices, GLuint indexCount, GLMesh& mesh, bool deduplicate = true)
+    {
+        return Add(vertices, vertexCount, indices, indexCount, GL_UNSIGNED_SHORT, deduplicate, mesh);
+    }
+
+    // Same for a mesh too large for 16-bit indices
+    bool Add(const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount, GLMesh& mesh, bool deduplicate = true)
+    {
+        return Add(vertices, vertexCount, indices, indexCount, GL_UNSIGNED_INT, deduplicate, mesh);
+    }
+
+    GLuint Vao() const { return mVao; }
+    GLuint VertexCount() const { return mVertexCount; }
+    GLuint IndexCount() const { return mIndexCount; }         // In GLushort slots
+    GLuint DuplicatesSkipped() const { return mDuplicates; }
+
+private:
+    bool Add(const void* vertices, GLuint vertexCount, const void* indices, GLuint indexCount, GLenum indexType, bool deduplicate, GLMesh& mesh)
+    {
+        // Element buffer bindings are VAO state, so only touch it with the arena's VAO bound
+        glBindVertexArray(mVao);
+
+        GLuint vertexOffset, indexOffset;
+        if (!Store(GL_ARRAY_BUFFER, mVbo, vertices, vertexCount, mVertexStride, 1, mMaxVertices, mVertexCount, deduplicate, mVertexBlocks, mVertexShadow, vertexOffset))
+        {
+            std::cout << "Mesh registry is out of vertex space (" << mMaxVertices << " vertices)" << std::endl;
+            glBindVertexArray(0);
+            return false;
+        }
+
+        // The index buffer is counted in GLushort slots; a GLuint index fills two and starts on an even one
+        GLuint slots = indexType == GL_UNSIGNED_INT ? 2 : 1;
+        if (!Store(GL_ELEMENT_ARRAY_BUFFER, mEbo, indices, indexCount * slots, sizeof(GLushort), slots, mMaxIndices, mIndexCount, deduplicate, mIndexBlocks, mIndexShadow, indexOffset))
+        {
+            std::cout << "Mesh registry is out of index space (" << mMaxIndices << " indices)" << std::endl;
+            glBindVertexArray(0);
+            return false;
+        }
+
+        mesh.baseVertex = (GLint)vertexOffset;
+        mesh.firstIndex = indexOffset / slots;
+        mesh.nIndices = indexCount;
+        mesh.indexType = indexType;
+        glBindVertexArray(0);
+        return true;
+    }
+
+    // An uploaded block of elements, remembered by the hash of its bytes
+    struct Block
+    {
+        GLuint offset;      // In elements
+        GLuint count;
+        size_t shadowOffset;    // Where its bytes start in the shadow copy
+    };
+    typedef std::unordered_multimap<uint64_t, Block> BlockMap;
+
+    GLuint mVao = 0;
+    GLuint mVbo = 0;
+    GLuint mEbo = 0;
+    GLuint mVertexStride = 0;
+    GLuint mMaxVertices = 0;
+    GLuint mMaxIndices = 0;
+    GLuint mVertexCount = 0;
+    GLuint mIndexCount = 0;
+    GLuint mDuplicates = 0;
+    BlockMap mVertexBlocks;
+    BlockMap mIndexBlocks;
+    std::vector<unsigned char> mVertexShadow;   // Every deduplicated block, to confirm hash matches without reading the buffers back
+    std::vector<unsigned char> mIndexShadow;
+
+    // 64-bit FNV-1a over the raw bytes
+    static uint64_t Hash(const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Appends count elements, starting on a multiple of alignment, unless deduplicating finds an identical block already there
+    bool Store(GLenum target, GLuint buffer, const void* data, GLuint count, GLuint elementSize, GLuint alignment,
+        GLuint capacity, GLuint& used, bool deduplicate, BlockMap& blocks, std::vector<unsigned char>& shadow, GLuint& offset)
+    {
+        size_t size = (size_t)count * elementSize;
+        uint64_t hash = deduplicate ? Hash(data, size) : 0;
+
+        // A hash match is confirmed against the CPU copy of the resident bytes before it is reused
+        auto range = deduplicate ? blocks.equal_range(hash) : std::make_pair(blocks.end(), blocks.end());
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second.count == count && it->second.offset % alignment == 0 && memcmp(shadow.data() + it->second.shadowOffset, data, size) == 0)
+            {
+                offset = it->second.offset;
+                ++mDuplicates;
+                return true;
+            }
+        }
+
+        GLuint start = (used + alignment - 1) / alignment * alignment;
+        if ((uint64_t)start + count > capacity)
+            return false;
+
+        offset = start;
+        glBindBuffer(target, buffer);
+        glBufferSubData(target, (GLintptr)offset * elementSize, size, data);
+        used = start + count;
+        if (deduplicate)
+        {
+            blocks.emplace(hash, Block{ offset, count, shadow.size() });
+            shadow.insert(shadow.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+        }
+        return true;
+    }
+};
+
+#endif
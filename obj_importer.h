@@ -0,0 +1,488 @@
+#ifndef OBJ_IMPORTER_H
+#define OBJ_IMPORTER_H
+
+#include <iostream>         // cout
+#include <cstddef>          // ptrdiff_t
+#include <cstdint>
+#include <cstdlib>          // strtod
+#include <cstring>          // memchr, memcpy
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+#include "job_system.h"
+#include "vertex_layout.h"  // SourceVertex
+#include "primitives.h"     // MeshData
+
+const size_t OBJ_CHUNK_SIZE = 1 << 20;  // Bytes of the file each job parses
+
+// An imported mesh; indices are 32-bit, so it may hold more than 65536 vertices
+struct ImportedMesh
+{
+    std::vector<SourceVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct ObjImportStats
+{
+    size_t bytes = 0;
+    unsigned chunks = 0;
+    size_t corners = 0;         // Face corners read, before welding
+};
+
+namespace obj
+{
+    // Position, texture and normal indices of a face corner, -1 where absent
+    struct Corner
+    {
+        int32_t position;
+        int32_t texCoord;
+        int32_t normal;
+
+        bool operator==(const Corner& other) const
+        {
+            return position == other.position && texCoord == other.texCoord && normal == other.normal;
+        }
+    };
+
+    struct CornerHash
+    {
+        size_t operator()(const Corner& corner) const
+        {
+            uint64_t h = (uint32_t)corner.position * 0x9E3779B97F4A7C15ull;
+            h ^= ((uint64_t)(uint32_t)corner.texCoord << 32 | (uint32_t)corner.normal) * 0xC2B2AE3D27D4EB4Full;
+            return (size_t)(h ^ (h >> 29));
+        }
+    };
+
+    enum class LineType { Other, Position, TexCoord, Normal, Face };
+
+    // A line-aligned slice of the file, parsed by one job
+    struct Chunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+
+        // First pass: what the slice holds
+        size_t lines = 0;
+        size_t positions = 0;
+        size_t texCoords = 0;
+        size_t normals = 0;
+
+        // Where its elements start in the whole file
+        size_t firstLine = 0;
+        size_t firstPosition = 0;
+        size_t firstTexCoord = 0;
+        size_t firstNormal = 0;
+
+        // Second pass: its faces, welded within the slice
+        std::vector<Corner> unique;             // Distinct corners, in order of first use
+        std::vector<uint32_t> corners;          // Index into unique for every corner
+        std::vector<uint32_t> faceSizes;
+        size_t triangles = 0;
+        size_t firstTriangle = 0;
+        std::vector<uint32_t> remap;            // unique to the welded mesh's vertices
+
+        std::string error;
+    };
+
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline const char* SkipSpace(const char* p, const char* end)
+    {
+        while (p < end && IsSpace(*p))
+            ++p;
+        return p;
+    }
+
+    // The line's keyword; p is left after it
+    inline LineType Classify(const char*& p, const char* end)
+    {
+        p = SkipSpace(p, end);
+        if (end - p >= 2 && IsSpace(p[1]) && (p[0] == 'v' || p[0] == 'f'))
+        {
+            p += 1;
+            return p[-1] == 'v' ? LineType::Position : LineType::Face;
+        }
+        if (end - p >= 3 && p[0] == 'v' && IsSpace(p[2]) && (p[1] == 't' || p[1] == 'n'))
+        {
+            p += 2;
+            return p[-1] == 't' ? LineType::TexCoord : LineType::Normal;
+        }
+        return LineType::Other;
+    }
+
+    /*
+     * Decimal float without going through the C locale: up to 19 significant
+     * digits are gathered into an integer and scaled by an exact power of ten,
+     * which is correctly rounded whenever both are exact doubles (Clinger's
+     * fast path; practically every number an exporter writes). Anything else
+     * goes to strtod. Returns the end of the number, or nullptr.
+     */
+    inline const char* ParseFloat(const char* p, const char* end, float& value)
+    {
+        static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int digits = 0;             // Significant digits in mantissa
+        int exponent = 0;
+        bool any = false;
+        for (; p < end && IsDigit(*p); ++p, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+            }
+            else
+                ++exponent;
+        }
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && IsDigit(*p); ++p, any = true)
+            {
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                }
+            }
+        }
+        if (!any)
+            return nullptr;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* e = p + 1;
+            bool negativeExponent = false;
+            if (e < end && (*e == '-' || *e == '+'))
+                negativeExponent = *e++ == '-';
+            if (e < end && IsDigit(*e))
+            {
+                int written = 0;
+                for (; e < end && IsDigit(*e); ++e)
+                    written = written < 10000 ? written * 10 + (*e - '0') : written;
+                exponent += negativeExponent ? -written : written;
+                p = e;
+            }
+        }
+
+        if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22)
+        {
+            double result = (double)mantissa;
+            result = exponent < 0 ? result / POWERS[-exponent] : result * POWERS[exponent];
+            value = (float)(negative ? -result : result);
+            return p;
+        }
+
+        // Rare: too many digits or a large exponent
+        char buffer[64];
+        size_t length = (size_t)(p - start);
+        if (length >= sizeof(buffer))
+            return nullptr;
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        value = (float)strtod(buffer, nullptr);
+        return p;
+    }
+
+    inline const char* ParseInt(const char* p, const char* end, long long& value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p >= end || !IsDigit(*p))
+            return nullptr;
+        value = 0;
+        for (; p < end && IsDigit(*p); ++p)
+            value = value < 1000000000000ll ? value * 10 + (*p - '0') : value;
+        if (negative)
+            value = -value;
+        return p;
+    }
+
+    // OBJ indices start at 1; negative ones count back from the last element read so far
+    inline bool Resolve(long long value, size_t readSoFar, size_t total, int32_t& index)
+    {
+        long long resolved = value > 0 ? value - 1 : (long long)readSoFar + value;
+        index = (int32_t)resolved;
+        return value != 0 && resolved >= 0 && (size_t)resolved < total && resolved <= INT32_MAX;
+    }
+
+    // First pass over a chunk: count lines and elements so every chunk knows where its own start
+    inline void Count(Chunk& chunk)
+    {
+        for (const char* line = chunk.begin; line < chunk.end; )
+        {
+            const char* lineEnd = (const char*)memchr(line, '\n', (size_t)(chunk.end - line));
+            if (!lineEnd)
+                lineEnd = chunk.end;
+            const char* p = line;
+            switch (Classify(p, lineEnd))
+            {
+            case LineType::Position: ++chunk.positions; break;
+            case LineType::TexCoord: ++chunk.texCoords; break;
+            case LineType::Normal:   ++chunk.normals; break;
+            default: break;
+            }
+            ++chunk.lines;
+            line = lineEnd + 1;
+        }
+    }
+
+    // Second pass: store the chunk's elements at their place in the file-wide arrays and weld its faces locally
+    inline void Parse(Chunk& chunk, size_t positionCount, size_t texCoordCount, size_t normalCount,
+                      std::vector<glm::vec3>& positions, std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& normals)
+    {
+        size_t nextPosition = chunk.firstPosition, nextTexCoord = chunk.firstTexCoord, nextNormal = chunk.firstNormal;
+        std::unordered_map<Corner, uint32_t, CornerHash> welded;
+        welded.reserve(chunk.positions);    // About one vertex per position in meshes that share them
+        size_t lineNumber = chunk.firstLine;
+        for (const char* line = chunk.begin; line < chunk.end; ++lineNumber)
+        {
+            const char* lineEnd = (const char*)memchr(line, '\n', (size_t)(chunk.end - line));
+            if (!lineEnd)
+                lineEnd = chunk.end;
+            const char* p = line;
+            LineType type = Classify(p, lineEnd);
+            bool valid = true;
+
+            if (type == LineType::Position || type == LineType::Normal)
+            {
+                glm::vec3 v;
+                for (int i = 0; i < 3 && valid; ++i)
+                    valid = (p = ParseFloat(SkipSpace(p, lineEnd), lineEnd, v[i])) != nullptr;
+                (type == LineType::Position ? positions[nextPosition++] : normals[nextNormal++]) = v;
+            }
+            else if (type == LineType::TexCoord)
+            {
+                // v is optional
+                glm::vec2 v(0.0f);
+                valid = (p = ParseFloat(SkipSpace(p, lineEnd), lineEnd, v.x)) != nullptr;
+                if (valid)
+                    ParseFloat(SkipSpace(p, lineEnd), lineEnd, v.y);
+                texCoords[nextTexCoord++] = v;
+            }
+            else if (type == LineType::Face)
+            {
+                // v, v/vt, v//vn or v/vt/vn corners
+                uint32_t size = 0;
+                for (p = SkipSpace(p, lineEnd); p < lineEnd && valid; p = SkipSpace(p, lineEnd), ++size)
+                {
+                    Corner corner = { -1, -1, -1 };
+                    long long value;
+                    valid = (p = ParseInt(p, lineEnd, value)) != nullptr && Resolve(value, nextPosition, positionCount, corner.position);
+                    if (valid && p < lineEnd && *p == '/')
+                    {
+                        ++p;
+                        if (p < lineEnd && *p != '/')
+                            valid = (p = ParseInt(p, lineEnd, value)) != nullptr && Resolve(value, nextTexCoord, texCoordCount, corner.texCoord);
+                        if (valid && p < lineEnd && *p == '/')
+                            valid = (p = ParseInt(p + 1, lineEnd, value)) != nullptr && Resolve(value, nextNormal, normalCount, corner.normal);
+                    }
+                    valid = valid && (p == lineEnd || IsSpace(*p));
+                    if (!valid)
+                        break;
+
+                    auto found = welded.emplace(corner, (uint32_t)chunk.unique.size());
+                    if (found.second)
+                        chunk.unique.push_back(corner);
+                    chunk.corners.push_back(found.first->second);
+                }
+                valid = valid && size >= 3;
+                if (valid)
+                {
+                    chunk.faceSizes.push_back(size);
+                    chunk.triangles += size - 2;
+                }
+            }
+
+            if (!valid)
+            {
+                chunk.error = "line " + std::to_string(lineNumber + 1) + ": " + std::string(line, lineEnd);
+                return;
+            }
+            line = lineEnd + 1;
+        }
+    }
+}
+
+/*
+ * Reads the v, vt, vn and f lines of a Wavefront OBJ file; everything else
+ * (groups, materials, ...) is ignored. Faces are triangulated as fans, and
+ * corners with the same position/texture/normal indices share a vertex.
+ *
+ * The file is mapped rather than read and cut into line-aligned chunks that
+ * jobs parse in parallel, in two passes: the first counts each chunk's
+ * elements, so the second can resolve relative indices and store every
+ * element straight at its final place. Each chunk welds its own corners, so
+ * the merge across chunks on the calling thread only hashes every chunk's
+ * distinct corners rather than every corner. The result matches a
+ * sequential read exactly.
+ */
+inline bool ImportObj(const char* filename, JobSystem& jobs, ImportedMesh& mesh, ObjImportStats* stats = nullptr)
+{
+    using namespace obj;
+    mesh = ImportedMesh();
+
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        std::cout << "Could not map " << filename << std::endl;
+        return false;
+    }
+
+    // Cut at the first line break after every OBJ_CHUNK_SIZE bytes
+    const char* data = (const char*)file.Data();
+    const char* end = data + file.Size();
+    std::vector<Chunk> chunks;
+    for (const char* begin = data; begin < end; )
+    {
+        const char* cut = end - begin > (ptrdiff_t)OBJ_CHUNK_SIZE ? begin + OBJ_CHUNK_SIZE : end;
+        const char* lineEnd = cut < end ? (const char*)memchr(cut, '\n', (size_t)(end - cut)) : nullptr;
+        cut = lineEnd ? lineEnd + 1 : end;
+        chunks.push_back(Chunk());
+        chunks.back().begin = begin;
+        chunks.back().end = cut;
+        begin = cut;
+    }
+    unsigned chunkCount = (unsigned)chunks.size();
+
+    jobs.ParallelFor(chunkCount, 1, [&](unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i < last; ++i)
+            Count(chunks[i]);
+    });
+
+    size_t lineCount = 0, positionCount = 0, texCoordCount = 0, normalCount = 0;
+    for (Chunk& chunk : chunks)
+    {
+        chunk.firstLine = lineCount;
+        chunk.firstPosition = positionCount;
+        chunk.firstTexCoord = texCoordCount;
+        chunk.firstNormal = normalCount;
+        lineCount += chunk.lines;
+        positionCount += chunk.positions;
+        texCoordCount += chunk.texCoords;
+        normalCount += chunk.normals;
+    }
+
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> texCoords(texCoordCount);
+    std::vector<glm::vec3> normals(normalCount);
+    jobs.ParallelFor(chunkCount, 1, [&](unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i < last; ++i)
+            Parse(chunks[i], positionCount, texCoordCount, normalCount, positions, texCoords, normals);
+    });
+
+    size_t triangleCount = 0;
+    for (Chunk& chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            std::cout << filename << ": invalid " << chunk.error << std::endl;
+            return false;
+        }
+        chunk.firstTriangle = triangleCount;
+        triangleCount += chunk.triangles;
+        if (stats)
+            stats->corners += chunk.corners.size();
+    }
+    if (triangleCount == 0)
+    {
+        std::cout << filename << " has no faces" << std::endl;
+        return false;
+    }
+
+    // Merge the chunks' vertices in file order
+    size_t uniqueCount = 0;
+    for (const Chunk& chunk : chunks)
+        uniqueCount += chunk.unique.size();
+    std::vector<Corner> vertices;
+    std::unordered_map<Corner, uint32_t, CornerHash> welded;
+    welded.reserve(uniqueCount);
+    for (Chunk& chunk : chunks)
+    {
+        chunk.remap.resize(chunk.unique.size());
+        for (size_t i = 0; i < chunk.unique.size(); ++i)
+        {
+            auto found = welded.emplace(chunk.unique[i], (uint32_t)vertices.size());
+            if (found.second)
+                vertices.push_back(chunk.unique[i]);
+            chunk.remap[i] = found.first->second;
+        }
+    }
+
+    mesh.vertices.resize(vertices.size());
+    mesh.indices.resize(triangleCount * 3);
+    jobs.ParallelFor((unsigned)vertices.size(), 4096, [&](unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            SourceVertex& vertex = mesh.vertices[i];
+            vertex.position = positions[vertices[i].position];
+            if (vertices[i].texCoord >= 0)
+                vertex.texCoord = texCoords[vertices[i].texCoord];
+            if (vertices[i].normal >= 0)
+                vertex.normal = normals[vertices[i].normal];
+        }
+    });
+    jobs.ParallelFor(chunkCount, 1, [&](unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            const Chunk& chunk = chunks[i];
+            uint32_t* out = mesh.indices.data() + chunk.firstTriangle * 3;
+            const uint32_t* face = chunk.corners.data();
+            for (uint32_t size : chunk.faceSizes)
+            {
+                for (uint32_t c = 2; c < size; ++c)
+                {
+                    *out++ = chunk.remap[face[0]];
+                    *out++ = chunk.remap[face[c - 1]];
+                    *out++ = chunk.remap[face[c]];
+                }
+                face += size;
+            }
+        }
+    });
+
+    if (stats)
+    {
+        stats->bytes = file.Size();
+        stats->chunks = chunkCount;
+    }
+    return true;
+}
+
+// Narrows an imported mesh to the 16-bit indices of a mesh arena level; false when it has too many vertices
+inline bool ToMeshData(const ImportedMesh& mesh, MeshData& data)
+{
+    if (mesh.vertices.size() > 65536)
+        return false;
+    data.vertices = mesh.vertices;
+    data.indices.assign(mesh.indices.begin(), mesh.indices.end());
+    return true;
+}
+
+#endif
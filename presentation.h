@@ -0,0 +1,183 @@
+#ifndef PRESENTATION_H
+#define PRESENTATION_H
+
+#include <iostream>         // cout
+#include <iomanip>          // setw, setprecision
+#include <cstring>          // strcmp
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <GL/glew.h>        // GLEW library
+
+#include "benchmark.h"      // FrameBenchmark::PrintRow
+
+/*
+ * How frames are paced and presented, trading throughput for input latency:
+ *
+ *     vsync        swap interval 1; the driver may queue a few frames ahead
+ *     uncapped     swap interval 0; as many frames as the GPU can take
+ *     limit        swap interval 0, frames started at a fixed rate by sleeping
+ *                  until shortly before each deadline and spinning the rest
+ *     low-latency  swap interval 1, and input is only sampled once the GPU has
+ *                  finished the previous frame (glFenceSync after each swap),
+ *                  so no frame waits in a queue with stale input
+ */
+enum class PresentMode { Vsync, Uncapped, Limit, LowLatency };
+
+inline bool ParsePresentMode(const char* name, PresentMode& mode)
+{
+    if (strcmp(name, "vsync") == 0)
+        mode = PresentMode::Vsync;
+    else if (strcmp(name, "uncapped") == 0)
+        mode = PresentMode::Uncapped;
+    else if (strcmp(name, "limit") == 0)
+        mode = PresentMode::Limit;
+    else if (strcmp(name, "low-latency") == 0)
+        mode = PresentMode::LowLatency;
+    else
+        return false;
+    return true;
+}
+
+inline const char* PresentModeName(PresentMode mode)
+{
+    switch (mode)
+    {
+    case PresentMode::Vsync:        return "vsync";
+    case PresentMode::Uncapped:     return "uncapped";
+    case PresentMode::Limit:        return "limit";
+    case PresentMode::LowLatency:   return "low-latency";
+    }
+    return "?";
+}
+
+/*
+ * Paces the render loop for a PresentMode and measures it:
+ *
+ *     pacer.WaitForFrame();       // limiter sleep / fence wait
+ *     ...sample input...
+ *     pacer.InputSampled();
+ *     ...simulate, render, swap...
+ *     pacer.Submitted();
+ *
+ * Input-to-submit latency runs from InputSampled() to Submitted(), i.e. until
+ * the swap call returned with the frame built from that input.
+ */
+class PresentPacer
+{
+public:
+    ~PresentPacer()
+    {
+        Destroy();
+    }
+
+    // targetRate only matters for PresentMode::Limit
+    void Create(PresentMode mode, double targetRate = 60.0)
+    {
+        mMode = mode;
+        mPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetRate));
+        mDeadline = Clock::now();
+        mHasSubmitted = false;
+        mFrameIntervals.clear();
+        mLatencies.clear();
+    }
+
+    void Destroy()
+    {
+        if (mFence)
+            glDeleteSync(mFence);
+        mFence = 0;
+    }
+
+    // Value for glfwSwapInterval / eglSwapInterval
+    int SwapInterval() const
+    {
+        return mMode == PresentMode::Vsync || mMode == PresentMode::LowLatency ? 1 : 0;
+    }
+
+    // Blocks until the next frame should start
+    void WaitForFrame()
+    {
+        if (mMode == PresentMode::Limit)
+        {
+            mDeadline += mPeriod;
+            Clock::time_point now = Clock::now();
+            if (now > mDeadline + mPeriod)
+                mDeadline = now;    // Fell a whole frame behind; restart the schedule instead of bursting
+            else
+                SleepUntil(mDeadline);
+        }
+        else if (mMode == PresentMode::LowLatency && mFence)
+        {
+            GLenum status = glClientWaitSync(mFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(mFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(mFence);
+            mFence = 0;
+        }
+    }
+
+    void InputSampled()
+    {
+        mInputTime = Clock::now();
+    }
+
+    void Submitted()
+    {
+        Clock::time_point now = Clock::now();
+        mLatencies.push_back(Milliseconds(now - mInputTime));
+        if (mHasSubmitted)
+            mFrameIntervals.push_back(Milliseconds(now - mLastSubmit));
+        mLastSubmit = now;
+        mHasSubmitted = true;
+
+        if (mMode == PresentMode::LowLatency)
+            mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void Report(std::ostream& out) const
+    {
+        out << "Presentation: " << PresentModeName(mMode) << std::endl;
+        out << std::fixed << std::setprecision(3);
+        out << "        " << std::setw(9) << "min" << std::setw(9) << "avg" << std::setw(9) << "p50"
+            << std::setw(9) << "p95" << std::setw(9) << "p99" << "   (ms, " << mLatencies.size() << " frames)" << std::endl;
+        FrameBenchmark::PrintRow(out, "Frame", mFrameIntervals);
+        FrameBenchmark::PrintRow(out, "Input", mLatencies);     // Input to submit
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Wake-ups from sleep are late by up to about a scheduler quantum; spin through the last stretch
+    static Clock::duration SpinMargin()
+    {
+        return std::chrono::milliseconds(2);
+    }
+
+    PresentMode mMode = PresentMode::Vsync;
+    Clock::duration mPeriod;
+    Clock::time_point mDeadline;
+    GLsync mFence = 0;
+
+    Clock::time_point mInputTime;
+    Clock::time_point mLastSubmit;
+    bool mHasSubmitted = false;
+    std::vector<double> mFrameIntervals;
+    std::vector<double> mLatencies;
+
+    static void SleepUntil(Clock::time_point deadline)
+    {
+        Clock::time_point now = Clock::now();
+        if (deadline - now > SpinMargin())
+            std::this_thread::sleep_for(deadline - now - SpinMargin());
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+    }
+
+    static double Milliseconds(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+};
+
+#endif
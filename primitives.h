@@ -0,0 +1,228 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <cmath>            // sin, cos
+#include <string>
+#include <vector>
+#include <algorithm>        // min, max
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include "vertex_layout.h"  // SourceVertex
+
+/*
+ * Procedural meshes, centered on the origin and filling a box of the given size:
+ *
+ *     box       six faces, each split into segments x segments quads
+ *     plane     the XZ plane (facing +Y), segments x segments quads
+ *     cylinder  along Y with both caps, segments slices around
+ *     sphere    segments slices around, segments / 2 stacks from pole to pole
+ *     pyramid   square base, apex on top (segments is ignored)
+ *
+ * Triangles wind counter-clockwise seen from outside. Generating the same
+ * primitive with fewer segments gives its lower levels of detail.
+ */
+struct MeshData
+{
+    std::vector<SourceVertex> vertices;
+    std::vector<GLushort> indices;
+};
+
+namespace primitives
+{
+    const float PI = 3.14159265358979f;
+    const int MAX_SEGMENTS = 100;   // Keeps every level inside GLushort indices (a box has 6 * 101^2 vertices)
+
+    // One face as a grid of quads spanning origin + u * [0, 1] + v * [0, 1]; u x v is the face normal
+    inline void AddGrid(MeshData& mesh, const glm::vec3& origin, const glm::vec3& u, const glm::vec3& v, int segments)
+    {
+        GLushort first = (GLushort)mesh.vertices.size();
+        glm::vec3 normal = glm::normalize(glm::cross(u, v));
+        for (int j = 0; j <= segments; ++j)
+        {
+            for (int i = 0; i <= segments; ++i)
+            {
+                SourceVertex vertex;
+                vertex.texCoord = glm::vec2((float)i / segments, (float)j / segments);
+                vertex.position = origin + u * vertex.texCoord.x + v * vertex.texCoord.y;
+                vertex.normal = normal;
+                mesh.vertices.push_back(vertex);
+            }
+        }
+
+        GLushort row = (GLushort)(segments + 1);
+        for (int j = 0; j < segments; ++j)
+        {
+            for (int i = 0; i < segments; ++i)
+            {
+                GLushort a = (GLushort)(first + j * row + i);
+                GLushort indices[6] = { a, (GLushort)(a + 1), (GLushort)(a + row + 1), a, (GLushort)(a + row + 1), (GLushort)(a + row) };
+                mesh.indices.insert(mesh.indices.end(), indices, indices + 6);
+            }
+        }
+    }
+
+    inline void GenerateBox(const glm::vec3& size, int segments, MeshData& mesh)
+    {
+        glm::vec3 h = size * 0.5f;
+        AddGrid(mesh, glm::vec3( h.x, -h.y,  h.z), glm::vec3(0, 0, -size.z), glm::vec3(0, size.y, 0), segments);  // +X
+        AddGrid(mesh, glm::vec3(-h.x, -h.y, -h.z), glm::vec3(0, 0,  size.z), glm::vec3(0, size.y, 0), segments);  // -X
+        AddGrid(mesh, glm::vec3(-h.x,  h.y,  h.z), glm::vec3(size.x, 0, 0), glm::vec3(0, 0, -size.z), segments);  // +Y
+        AddGrid(mesh, glm::vec3(-h.x, -h.y, -h.z), glm::vec3(size.x, 0, 0), glm::vec3(0, 0,  size.z), segments);  // -Y
+        AddGrid(mesh, glm::vec3(-h.x, -h.y,  h.z), glm::vec3( size.x, 0, 0), glm::vec3(0, size.y, 0), segments);  // +Z
+        AddGrid(mesh, glm::vec3( h.x, -h.y, -h.z), glm::vec3(-size.x, 0, 0), glm::vec3(0, size.y, 0), segments);  // -Z
+    }
+
+    inline void GeneratePlane(const glm::vec3& size, int segments, MeshData& mesh)
+    {
+        AddGrid(mesh, glm::vec3(-size.x * 0.5f, 0.0f, size.z * 0.5f), glm::vec3(size.x, 0, 0), glm::vec3(0, 0, -size.z), segments);
+    }
+
+    inline void GenerateCylinder(const glm::vec3& size, int slices, MeshData& mesh)
+    {
+        glm::vec3 h = size * 0.5f;
+
+        // Side: a bottom and a top vertex per slice, the seam duplicated for its texture coordinates
+        GLushort side = (GLushort)mesh.vertices.size();
+        for (int i = 0; i <= slices; ++i)
+        {
+            float angle = 2.0f * PI * i / slices;
+            glm::vec3 ring(std::cos(angle), 0.0f, -std::sin(angle));
+            for (int top = 0; top < 2; ++top)
+            {
+                SourceVertex vertex;
+                vertex.position = glm::vec3(ring.x * h.x, top ? h.y : -h.y, ring.z * h.z);
+                vertex.normal = glm::normalize(glm::vec3(ring.x / h.x, 0.0f, ring.z / h.z));
+                vertex.texCoord = glm::vec2((float)i / slices, (float)top);
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        for (int i = 0; i < slices; ++i)
+        {
+            GLushort bottom = (GLushort)(side + 2 * i), next = (GLushort)(bottom + 2);
+            GLushort indices[6] = { bottom, next, (GLushort)(next + 1), bottom, (GLushort)(next + 1), (GLushort)(bottom + 1) };
+            mesh.indices.insert(mesh.indices.end(), indices, indices + 6);
+        }
+
+        // Caps: a fan around a center vertex each
+        for (int top = 0; top < 2; ++top)
+        {
+            float y = top ? h.y : -h.y;
+            GLushort center = (GLushort)mesh.vertices.size();
+            SourceVertex vertex;
+            vertex.position = glm::vec3(0.0f, y, 0.0f);
+            vertex.normal = glm::vec3(0.0f, top ? 1.0f : -1.0f, 0.0f);
+            vertex.texCoord = glm::vec2(0.5f);
+            mesh.vertices.push_back(vertex);
+            for (int i = 0; i <= slices; ++i)
+            {
+                float angle = 2.0f * PI * i / slices;
+                vertex.position = glm::vec3(std::cos(angle) * h.x, y, -std::sin(angle) * h.z);
+                vertex.texCoord = glm::vec2(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle));
+                mesh.vertices.push_back(vertex);
+            }
+            for (int i = 0; i < slices; ++i)
+            {
+                GLushort a = (GLushort)(center + 1 + i), b = (GLushort)(a + 1);
+                GLushort indices[3] = { center, top ? a : b, top ? b : a };
+                mesh.indices.insert(mesh.indices.end(), indices, indices + 3);
+            }
+        }
+    }
+
+    inline void GenerateSphere(const glm::vec3& size, int slices, MeshData& mesh)
+    {
+        glm::vec3 h = size * 0.5f;
+        int stacks = std::max(2, slices / 2);
+        GLushort first = (GLushort)mesh.vertices.size();
+        for (int j = 0; j <= stacks; ++j)
+        {
+            float polar = PI * j / stacks;
+            for (int i = 0; i <= slices; ++i)
+            {
+                float angle = 2.0f * PI * i / slices;
+                glm::vec3 unit(std::sin(polar) * std::cos(angle), std::cos(polar), -std::sin(polar) * std::sin(angle));
+                SourceVertex vertex;
+                vertex.position = unit * h;
+                vertex.normal = unit;
+                vertex.texCoord = glm::vec2((float)i / slices, 1.0f - (float)j / stacks);
+                mesh.vertices.push_back(vertex);
+            }
+        }
+
+        GLushort row = (GLushort)(slices + 1);
+        for (int j = 0; j < stacks; ++j)
+        {
+            for (int i = 0; i < slices; ++i)
+            {
+                GLushort a = (GLushort)(first + j * row + i);
+                GLushort indices[6] = { a, (GLushort)(a + row), (GLushort)(a + row + 1), a, (GLushort)(a + row + 1), (GLushort)(a + 1) };
+                mesh.indices.insert(mesh.indices.end(), indices, indices + 6);
+            }
+        }
+    }
+
+    // Adds a flat triangle, flipped if needed so it faces away from the origin
+    inline void AddOutwardTriangle(MeshData& mesh, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec2 ta, glm::vec2 tb, glm::vec2 tc)
+    {
+        glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+        if (glm::dot(normal, a + b + c) < 0.0f)
+        {
+            std::swap(b, c);
+            std::swap(tb, tc);
+            normal = -normal;
+        }
+
+        GLushort first = (GLushort)mesh.vertices.size();
+        const glm::vec3 positions[3] = { a, b, c };
+        const glm::vec2 texCoords[3] = { ta, tb, tc };
+        for (int i = 0; i < 3; ++i)
+        {
+            SourceVertex vertex;
+            vertex.position = positions[i];
+            vertex.normal = normal;
+            vertex.texCoord = texCoords[i];
+            mesh.vertices.push_back(vertex);
+            mesh.indices.push_back((GLushort)(first + i));
+        }
+    }
+
+    inline void GeneratePyramid(const glm::vec3& size, MeshData& mesh)
+    {
+        glm::vec3 h = size * 0.5f;
+        glm::vec3 apex(0.0f, h.y, 0.0f);
+        glm::vec3 base[4] = {
+            glm::vec3(-h.x, -h.y,  h.z), glm::vec3( h.x, -h.y,  h.z),
+            glm::vec3( h.x, -h.y, -h.z), glm::vec3(-h.x, -h.y, -h.z),
+        };
+        for (int i = 0; i < 4; ++i)
+            AddOutwardTriangle(mesh, base[i], base[(i + 1) % 4], apex, glm::vec2(0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.5f, 1.0f));
+        AddOutwardTriangle(mesh, base[0], base[1], base[2], glm::vec2(0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(1.0f));
+        AddOutwardTriangle(mesh, base[0], base[2], base[3], glm::vec2(0.0f), glm::vec2(1.0f), glm::vec2(0.0f, 1.0f));
+    }
+}
+
+
+// Generates a primitive by its scene file name; false for an unknown type
+inline bool GeneratePrimitive(const std::string& type, const glm::vec3& size, int segments, MeshData& mesh)
+{
+    mesh = MeshData();
+    segments = std::max(1, std::min(segments, primitives::MAX_SEGMENTS));
+    if (type == "box")
+        primitives::GenerateBox(size, segments, mesh);
+    else if (type == "plane")
+        primitives::GeneratePlane(size, segments, mesh);
+    else if (type == "cylinder")
+        primitives::GenerateCylinder(size, std::max(3, segments), mesh);
+    else if (type == "sphere")
+        primitives::GenerateSphere(size, std::max(3, segments), mesh);
+    else if (type == "pyramid")
+        primitives::GeneratePyramid(size, mesh);
+    else
+        return false;
+    return true;
+}
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iostream>         // cout
+#include <fstream>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <GL/glew.h>        // GLEW library
+
+/*
+ * Scoped CPU and GPU zones, exported as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+ *
+ *     CpuZone zone(profiler, "Sort");     // steady_clock from construction to destruction
+ *     GpuZone pass(profiler, "Submit");   // GPU timestamps around the commands issued in scope
+ *
+ * Samples go into a fixed ring that any thread can append to without locking;
+ * once it wraps, the oldest samples are overwritten. GPU zones are bracketed by
+ * GL_TIMESTAMP queries rather than GL_TIME_ELAPSED, because elapsed queries
+ * cannot nest and FrameBenchmark already keeps one open around each frame.
+ * Their results are read two frames later, and only if the GPU has them, so
+ * profiling never waits on the GPU. Zone names must be string literals.
+ */
+class Profiler
+{
+public:
+    ~Profiler()
+    {
+        Destroy();
+    }
+
+    // Starts recording; needs the GL context current, before any thread records zones
+    void Create()
+    {
+        mEpoch = std::chrono::steady_clock::now();
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        mGpuToCpu = CpuNow() - gpuNow;
+
+        mSamples = std::vector<Slot>(RING_SIZE);
+        mWriteIndex = 0;
+        mFrameIndex = 0;
+        mDroppedGpuZones = 0;
+        mEnabled = true;
+    }
+
+    void Destroy()
+    {
+        mEnabled = false;
+        for (GpuFrame& frame : mGpuFrames)
+        {
+            if (!frame.queries.empty())
+                glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+            frame.queries.clear();
+            frame.zones.clear();
+        }
+        mSamples.clear();
+    }
+
+    bool Enabled() const
+    {
+        return mEnabled;
+    }
+
+    // Call once per frame on the GL thread; collects the GPU zones of two frames ago
+    void BeginFrame()
+    {
+        if (!mEnabled)
+            return;
+        ++mFrameIndex;
+        ResolveGpuFrame(mGpuFrames[mFrameIndex % GPU_FRAME_COUNT], false);
+    }
+
+    // Waits for every GPU zone still in flight; call before WriteChromeTrace()
+    void Finish()
+    {
+        if (!mEnabled)
+            return;
+        for (GpuFrame& frame : mGpuFrames)
+            ResolveGpuFrame(frame, true);
+        if (mDroppedGpuZones > 0)
+            std::cout << "Profiler: dropped " << mDroppedGpuZones << " GPU zones that were not ready in time" << std::endl;
+    }
+
+    // Writes the recorded samples in the Trace Event Format; false when the file cannot be written
+    bool WriteChromeTrace(const char* filename) const
+    {
+        std::ofstream file(filename);
+        if (!file)
+        {
+            std::cout << "Could not write profile " << filename << std::endl;
+            return false;
+        }
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+
+        uint64_t written = mWriteIndex.load(std::memory_order_acquire);
+        uint64_t first = written > RING_SIZE ? written - RING_SIZE : 0;
+        for (uint64_t index = first; index < written; ++index)
+        {
+            const Slot& slot = mSamples[index % RING_SIZE];
+            if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+                continue;   // Still being written, or already overwritten
+
+            file << ",\n{\"name\":\"" << slot.sample.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << slot.sample.thread
+                 << ",\"ts\":" << slot.sample.start / 1000.0 << ",\"dur\":" << slot.sample.duration / 1000.0 << "}";
+        }
+        file << "\n]}\n";
+        return true;
+    }
+
+    // Nanoseconds since Create()
+    int64_t CpuNow() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mEpoch).count();
+    }
+
+    void Record(const char* name, int64_t start, int64_t duration, uint32_t thread)
+    {
+        uint64_t index = mWriteIndex.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = mSamples[index % RING_SIZE];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        slot.sample = Sample{ name, start, duration, thread };
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    // Issues the opening timestamp of a GPU zone; returns its index for EndGpuZone()
+    size_t BeginGpuZone(const char* name)
+    {
+        GpuFrame& frame = mGpuFrames[mFrameIndex % GPU_FRAME_COUNT];
+        size_t zone = frame.zones.size();
+        if (frame.queries.size() < 2 * (zone + 1))
+        {
+            frame.queries.resize(2 * (zone + 1));
+            glGenQueries(2, &frame.queries[2 * zone]);
+        }
+        frame.zones.push_back(name);
+        glQueryCounter(frame.queries[2 * zone], GL_TIMESTAMP);
+        return zone;
+    }
+
+    void EndGpuZone(size_t zone)
+    {
+        GpuFrame& frame = mGpuFrames[mFrameIndex % GPU_FRAME_COUNT];
+        glQueryCounter(frame.queries[2 * zone + 1], GL_TIMESTAMP);
+    }
+
+    // Small per-thread id for the trace, assigned on first use
+    static uint32_t ThreadId()
+    {
+        static std::atomic<uint32_t> nextId(GPU_THREAD + 1);
+        thread_local uint32_t id = nextId.fetch_add(1);
+        return id;
+    }
+
+    static const uint32_t GPU_THREAD = 0;
+
+private:
+    static const size_t RING_SIZE = 1 << 16;
+    static const unsigned GPU_FRAME_COUNT = 2;
+
+    struct Sample
+    {
+        const char* name;
+        int64_t start;          // ns since Create()
+        int64_t duration;       // ns
+        uint32_t thread;
+    };
+
+    // sequence is index + 1 once the sample at that ring index is complete
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        Sample sample;
+
+        Slot() : sequence(0), sample() {}
+        Slot(const Slot&) : sequence(0), sample() {}
+    };
+
+    // Query pairs (begin, end) for the zones opened during one frame
+    struct GpuFrame
+    {
+        std::vector<const char*> zones;
+        std::vector<GLuint> queries;
+    };
+
+    bool mEnabled = false;
+    std::chrono::steady_clock::time_point mEpoch;
+    int64_t mGpuToCpu = 0;
+    std::vector<Slot> mSamples;
+    std::atomic<uint64_t> mWriteIndex{ 0 };
+
+    GpuFrame mGpuFrames[GPU_FRAME_COUNT];
+    unsigned mFrameIndex = 0;
+    unsigned mDroppedGpuZones = 0;
+
+    void ResolveGpuFrame(GpuFrame& frame, bool wait)
+    {
+        for (size_t zone = 0; zone < frame.zones.size(); ++zone)
+        {
+            GLuint available = GL_TRUE;
+            if (!wait)
+                glGetQueryObjectuiv(frame.queries[2 * zone + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                ++mDroppedGpuZones;
+                continue;
+            }
+
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[2 * zone], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[2 * zone + 1], GL_QUERY_RESULT, &end);
+            Record(frame.zones[zone], (int64_t)begin + mGpuToCpu, (int64_t)(end - begin), GPU_THREAD);
+        }
+        frame.zones.clear();
+    }
+};
+
+
+// Times its own lifetime on the calling thread
+class CpuZone
+{
+public:
+    CpuZone(Profiler& profiler, const char* name)
+        : mProfiler(profiler.Enabled() ? &profiler : nullptr), mName(name)
+    {
+        if (mProfiler)
+            mStart = mProfiler->CpuNow();
+    }
+
+    ~CpuZone()
+    {
+        if (mProfiler)
+            mProfiler->Record(mName, mStart, mProfiler->CpuNow() - mStart, Profiler::ThreadId());
+    }
+
+private:
+    Profiler* mProfiler;
+    const char* mName;
+    int64_t mStart = 0;
+};
+
+
+// Times the GL commands issued during its lifetime; GL thread only
+class GpuZone
+{
+public:
+    GpuZone(Profiler& profiler, const char* name)
+        : mProfiler(profiler.Enabled() ? &profiler : nullptr)
+    {
+        if (mProfiler)
+            mZone = mProfiler->BeginGpuZone(name);
+    }
+
+    ~GpuZone()
+    {
+        if (mProfiler)
+            mProfiler->EndGpuZone(mZone);
+    }
+
+private:
+    Profiler* mProfiler;
+    size_t mZone = 0;
+};
+
+#endif
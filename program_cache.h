@@ -0,0 +1,143 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <iostream>         // cout
+#include <cstdio>           // fopen, fread, fwrite, remove, snprintf
+#include <cstdint>
+#include <cstring>          // memcmp
+#include <string>
+#include <vector>
+#include <GL/glew.h>        // GLEW library
+
+const char PROGRAM_CACHE_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+
+/*
+ * Disk store for linked program binaries (glGetProgramBinary/glProgramBinary).
+ *
+ * A program is keyed by a hash of its shader sources, defines and the
+ * driver's vendor, renderer and version strings, so a driver update or a
+ * different GPU simply misses the cache. Drivers may still reject a binary
+ * they wrote themselves; ShaderProgram::Build() then compiles from source and
+ * overwrites the entry. Each entry is one file, "<prefix><key>.bin".
+ */
+class ProgramBinaryCache
+{
+public:
+    explicit ProgramBinaryCache(const std::string& prefix = "shader_cache_")
+        : mPrefix(prefix)
+    {
+    }
+
+    // False when the driver offers no binary formats, in which case nothing is cached
+    bool Supported() const
+    {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    uint64_t Key(const char* vtxShaderSource, const char* fragShaderSource, const char* defines) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        const char* parts[] = {
+            vtxShaderSource, fragShaderSource, defines ? defines : "",
+            (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION),
+        };
+        for (const char* part : parts)
+        {
+            // Include the terminator so ("ab", "c") and ("a", "bc") differ
+            for (const char* c = part ? part : ""; ; ++c)
+            {
+                hash ^= (unsigned char)*c;
+                hash *= 1099511628211ull;
+                if (!*c)
+                    break;
+            }
+        }
+        return hash;
+    }
+
+    // Links program from the stored binary; false on a miss or when the driver rejects it
+    bool Load(uint64_t key, GLuint program) const
+    {
+        std::string path = Path(key);
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        Header header;
+        std::vector<unsigned char> binary;
+        bool read = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) == 0
+            && header.key == key && header.length > 0;
+        if (read)
+        {
+            binary.resize(header.length);
+            read = fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        fclose(file);
+        if (!read)
+            return false;
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            std::cout << "Cached program binary " << path << " was rejected, compiling from source" << std::endl;
+            remove(path.c_str());
+        }
+        return success != 0;
+    }
+
+    // Saves a linked program; it must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    bool Store(uint64_t key, GLuint program) const
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+
+        Header header;
+        memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+        header.key = key;
+        std::vector<unsigned char> binary(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format, binary.data());
+        if (written <= 0)
+            return false;
+        header.length = (uint32_t)written;
+
+        std::string path = Path(key);
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        bool stored = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, written, file) == (size_t)written;
+        stored = fclose(file) == 0 && stored;
+        if (!stored)
+        {
+            std::cout << "Could not write program binary " << path << std::endl;
+            remove(path.c_str());
+        }
+        return stored;
+    }
+
+private:
+    struct Header
+    {
+        char magic[4];
+        GLenum format = 0;
+        uint32_t length = 0;
+        uint64_t key = 0;
+    };
+
+    std::string mPrefix;
+
+    std::string Path(uint64_t key) const
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+        return mPrefix + name + ".bin";
+    }
+};
+
+#endif
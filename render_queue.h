@@ -0,0 +1,244 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>        // sort, max, inplace_merge
+#include <iostream>         // cout
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "command_list.h"   // DrawItem, DrawSortKey, CommandList
+#include "upload_ring.h"    // UploadRing
+
+// Per-draw data, matching the std430 layout of
+//     struct DrawData { mat4 model; int flags; };
+//     layout(std430, binding = 0) readonly buffer DrawBlock { DrawData draws[]; };
+//     layout(location = 3) in uint drawId;
+// which shaders read as draws[drawId]
+struct DrawData
+{
+    glm::mat4 model;
+    GLint flags;
+    GLint padding[3];                   // std430 rounds the struct up to its 16-byte alignment
+};
+
+// What the last Submit() cost
+struct RenderStats
+{
+    unsigned drawCalls = 0;
+    unsigned instances = 0;
+    unsigned stateChanges = 0;
+};
+
+/*
+ * Collects a frame's draws, sorts them by their state key (see DrawSortKey)
+ * and submits them, only touching GL state that differs from the previous draw.
+ * Draws are either pushed one at a time and sorted here, or recorded into
+ * CommandLists on other threads and merged in with Append().
+ *
+ * Consecutive draws that share all of their state become a single
+ * glDrawElementsInstancedBaseVertexBaseInstance call. Every draw's model matrix
+ * and flags are written once per frame, in sorted order, straight into a
+ * persistently mapped UploadRing and bound as the DrawBlock storage buffer.
+ * Shaders find their entry through drawId, an instanced attribute read from a
+ * constant 0, 1, 2, ... buffer, so the base instance of each batch selects its
+ * first entry (gl_InstanceID does not include the base instance before GL 4.6).
+ */
+class RenderQueue
+{
+public:
+    static const GLuint DRAW_ID_LOCATION = 3;
+    static const GLuint DRAW_DATA_BINDING = 0;
+
+    bool Create()
+    {
+        GLint vertexStorageBlocks = 0;
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+        if (vertexStorageBlocks <= (GLint)DRAW_DATA_BINDING)
+        {
+            std::cout << "Vertex shaders cannot read storage buffers on this driver" << std::endl;
+            return false;
+        }
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &mDataAlignment);
+
+        glGenBuffers(1, &mDrawIdBuffer);
+        return ReserveDraws(INITIAL_DRAWS);
+    }
+
+    void Destroy()
+    {
+        mDrawData.Destroy();
+        glDeleteBuffers(1, &mDrawIdBuffer);
+        mDrawIdBuffer = 0;
+        mCapacity = 0;
+    }
+
+    // Adds the drawId attribute to a mesh's vertex array; call once per VAO after Create()
+    void AttachInstanceAttributes(GLuint vao) const
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+        glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+        glEnableVertexAttribArray(DRAW_ID_LOCATION);
+        glBindVertexArray(0);
+    }
+
+    void Clear()
+    {
+        mItems.clear();
+    }
+
+    // Queues a draw; viewDepth is the distance along the view direction, in [0, maxDepth)
+    void Push(const DrawItem& item, float viewDepth, float maxDepth)
+    {
+        mItems.push_back(item);
+        mItems.back().key = DrawSortKey(item, viewDepth, maxDepth);
+    }
+
+    void Sort()
+    {
+        std::sort(mItems.begin(), mItems.end(),
+            [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+    }
+
+    // Merges a sorted command list into the queue, which must be sorted too; the queue stays sorted
+    void Append(const CommandList& list)
+    {
+        size_t middle = mItems.size();
+        mItems.insert(mItems.end(), list.Items().begin(), list.Items().end());
+        std::inplace_merge(mItems.begin(), mItems.begin() + middle, mItems.end(),
+            [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+    }
+
+    // Writes the per-draw data and issues the queued draws in key order
+    RenderStats Submit()
+    {
+        RenderStats stats;
+        if (mItems.empty() || !ReserveDraws(mItems.size()))
+            return stats;
+
+        // Entries are stored in sorted order, so every batch is a contiguous range
+        mDrawData.BeginFrame();
+        GLsizeiptr size = sizeof(DrawData) * mItems.size();
+        GLintptr offset = 0;
+        DrawData* draws = (DrawData*)mDrawData.Allocate(size, mDataAlignment, offset);
+        for (size_t i = 0; i < mItems.size(); ++i)
+        {
+            draws[i].model = mItems[i].model;
+            draws[i].flags = mItems[i].flags;
+        }
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, mDrawData.Buffer(), offset, size);
+
+        GLuint currentProgram = 0;
+        GLuint currentTextures[2] = { 0, 0 };
+        GLuint currentVao = INVALID;
+
+        for (size_t first = 0; first < mItems.size(); )
+        {
+            const DrawItem& item = mItems[first];
+
+            // Extend the batch over every following item with identical state
+            size_t last = first + 1;
+            while (last < mItems.size() && SameBatch(item, mItems[last]))
+                ++last;
+
+            if (item.program != currentProgram)
+            {
+                glUseProgram(item.program);
+                currentProgram = item.program;
+                ++stats.stateChanges;
+            }
+
+            for (GLuint unit = 0; unit < 2; ++unit)
+            {
+                if (item.textures[unit] == currentTextures[unit])
+                    continue;
+                glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(GL_TEXTURE_2D, item.textures[unit]);
+                currentTextures[unit] = item.textures[unit];
+                ++stats.stateChanges;
+            }
+
+            if (item.vao != currentVao)
+            {
+                glBindVertexArray(item.vao);
+                currentVao = item.vao;
+                ++stats.stateChanges;
+            }
+            size_t indexSize = item.indexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, item.indexCount, item.indexType,
+                (void*)(indexSize * item.firstIndex), (GLsizei)(last - first), item.baseVertex, (GLuint)first);
+
+            ++stats.drawCalls;
+            stats.instances += (unsigned)(last - first);
+            first = last;
+        }
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        mDrawData.EndFrame();
+        return stats;
+    }
+
+    size_t Size() const
+    {
+        return mItems.size();
+    }
+
+    // Frames whose draw data had to wait for the GPU to release its region of the ring
+    unsigned DrawDataStalls() const
+    {
+        return mDrawData.Stalls();
+    }
+
+private:
+    static const GLuint INVALID = ~0u;
+    static const size_t INITIAL_DRAWS = 1024;
+
+    UploadRing mDrawData;
+    GLuint mDrawIdBuffer = 0;           // 0, 1, 2, ... read by the drawId attribute
+    size_t mCapacity = 0;               // Draws both buffers have room for
+    GLint mDataAlignment = 1;
+    std::vector<DrawItem> mItems;
+
+    // Grows the draw data ring and the drawId buffer to hold at least count draws
+    bool ReserveDraws(size_t count)
+    {
+        if (count <= mCapacity)
+            return true;
+        size_t capacity = std::max(mCapacity, INITIAL_DRAWS);
+        while (capacity < count)
+            capacity *= 2;
+
+        // Whole regions, so every frame's first entry keeps the storage buffer offset alignment
+        GLsizeiptr frameSize = (GLsizeiptr)(sizeof(DrawData) * capacity);
+        frameSize = (frameSize + mDataAlignment - 1) / mDataAlignment * mDataAlignment;
+        if (!mDrawData.Reserve(frameSize))
+            return false;
+
+        // Same buffer name, so the attribute setup in every VAO stays valid
+        std::vector<GLuint> ids(capacity);
+        for (size_t i = 0; i < capacity; ++i)
+            ids[i] = (GLuint)i;
+        glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * capacity, ids.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        mCapacity = capacity;
+        return true;
+    }
+
+    static bool SameBatch(const DrawItem& a, const DrawItem& b)
+    {
+        return a.program == b.program && a.vao == b.vao
+            && a.baseVertex == b.baseVertex && a.firstIndex == b.firstIndex && a.indexCount == b.indexCount && a.indexType == b.indexType
+            && a.textures[0] == b.textures[0] && a.textures[1] == b.textures[1];
+    }
+};
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <iostream>         // cout
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+/*
+ * Text scene description. Blank lines and lines starting with '#' are ignored.
+ *
+ *     texture <name> <image file>
+ *
+ *     model <mesh name> <mesh file or .obj file>         (mesh files are written by MeshConverter)
+ *
+ *     primitive <mesh name> <box|plane|cylinder|sphere|pyramid>
+ *         size <x> <y> <z>
+ *         lod <segments> <min screen size>               (one per level, most detailed first)
+ *     end
+ *
+ *     object <name>
+ *         mesh <mesh name>
+ *         texture <texture name> [<extra texture name>]
+ *         translate <x> <y> <z>
+ *         rotate <degrees> <axis x> <axis y> <axis z>    (may repeat, applied in order)
+ *         scale <x> <y> <z>
+ *         spin <degrees per second> <axis x> <axis y> <axis z>
+ *     end
+ *
+ * The model matrix is translate * rotate... * scale, the same order the
+ * hand-written scenes used. An object with a spin keeps turning about the
+ * axis through its origin, before its other rotations, as the simulation
+ * advances.
+ *
+ * A primitive declares a generated mesh that objects can use by name. Each
+ * frame the most detailed level whose min screen size is at most the object's
+ * projected height (as a fraction of the viewport) is drawn. A model declares
+ * a mesh the same way, with its levels read from a binary mesh file, or a
+ * single level imported from a Wavefront OBJ file.
+ */
+struct SceneTexture
+{
+    std::string name;
+    std::string filename;
+};
+
+struct SceneModel
+{
+    std::string name;
+    std::string filename;
+};
+
+struct SceneLod
+{
+    int segments = 16;
+    float minScreenSize = 0.0f;
+};
+
+struct ScenePrimitive
+{
+    std::string name;
+    std::string type;
+    glm::vec3 size = glm::vec3(1.0f);
+    std::vector<SceneLod> lods;
+};
+
+struct SceneObject
+{
+    std::string name;
+    std::string mesh;
+    std::string textures[2];            // Base and optional extra texture names
+    glm::vec3 translation = glm::vec3(0.0f);
+    std::vector<glm::vec4> rotations;   // (degrees, axis x, axis y, axis z)
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::vec4 spin = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);  // (degrees per second, axis x, axis y, axis z)
+    glm::mat4 model = glm::mat4(1.0f);  // Computed from the components above when loading, unspun
+
+    bool HasExtraTexture() const
+    {
+        return !textures[1].empty();
+    }
+
+    bool Spins() const
+    {
+        return spin.x != 0.0f;
+    }
+
+    // Model matrix once the object has spun by spinAngle degrees
+    glm::mat4 ModelMatrix(float spinAngle) const
+    {
+        glm::mat4 rotation(1.0f);
+        if (spinAngle != 0.0f)
+            rotation = glm::rotate(glm::radians(spinAngle), glm::vec3(spin.y, spin.z, spin.w));
+        for (const glm::vec4& r : rotations)
+            rotation = rotation * glm::rotate(glm::radians(r.x), glm::vec3(r.y, r.z, r.w));
+        return glm::translate(translation) * rotation * glm::scale(scale);
+    }
+
+    void UpdateModelMatrix()
+    {
+        model = ModelMatrix(0.0f);
+    }
+};
+
+struct Scene
+{
+    std::vector<SceneTexture> textures;
+    std::vector<ScenePrimitive> primitives;
+    std::vector<SceneModel> models;
+    std::vector<SceneObject> objects;
+
+    // Index of a texture by name, or -1
+    int FindTexture(const std::string& name) const
+    {
+        for (size_t i = 0; i < textures.size(); ++i)
+            if (textures[i].name == name)
+                return (int)i;
+        return -1;
+    }
+};
+
+
+// Parses a scene file; prints the offending line and returns false on error
+inline bool LoadScene(const char* filename, Scene& scene)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cout << "Failed to open scene " << filename << std::endl;
+        return false;
+    }
+
+    scene = Scene();
+    SceneObject* object = nullptr;
+    ScenePrimitive* primitive = nullptr;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword) || keyword[0] == '#')
+            continue;
+
+        bool valid = true;
+        if (primitive && keyword == "size")
+            valid = (bool)(in >> primitive->size.x >> primitive->size.y >> primitive->size.z);
+        else if (primitive && keyword == "lod")
+        {
+            SceneLod lod;
+            valid = (bool)(in >> lod.segments >> lod.minScreenSize);
+            primitive->lods.push_back(lod);
+        }
+        else if (primitive && keyword == "end")
+        {
+            // Without lod lines the primitive has a single level with the default segment count
+            if (primitive->lods.empty())
+                primitive->lods.push_back(SceneLod());
+            primitive = nullptr;
+        }
+        else if (primitive)
+            valid = false;
+        else if (!object && keyword == "primitive")
+        {
+            scene.primitives.push_back(ScenePrimitive());
+            primitive = &scene.primitives.back();
+            valid = (bool)(in >> primitive->name >> primitive->type);
+        }
+        else if (!object && keyword == "texture")
+        {
+            SceneTexture texture;
+            valid = (bool)(in >> texture.name >> texture.filename);
+            scene.textures.push_back(texture);
+        }
+        else if (!object && keyword == "model")
+        {
+            SceneModel model;
+            valid = (bool)(in >> model.name >> model.filename);
+            scene.models.push_back(model);
+        }
+        else if (!object && keyword == "object")
+        {
+            scene.objects.push_back(SceneObject());
+            object = &scene.objects.back();
+            valid = (bool)(in >> object->name);
+        }
+        else if (object && keyword == "mesh")
+            valid = (bool)(in >> object->mesh);
+        else if (object && keyword == "texture")
+        {
+            valid = (bool)(in >> object->textures[0]);
+            in >> object->textures[1];
+        }
+        else if (object && keyword == "translate")
+            valid = (bool)(in >> object->translation.x >> object->translation.y >> object->translation.z);
+        else if (object && keyword == "rotate")
+        {
+            glm::vec4 rotation;
+            valid = (bool)(in >> rotation.x >> rotation.y >> rotation.z >> rotation.w);
+            object->rotations.push_back(rotation);
+        }
+        else if (object && keyword == "scale")
+            valid = (bool)(in >> object->scale.x >> object->scale.y >> object->scale.z);
+        else if (object && keyword == "spin")
+            valid = (bool)(in >> object->spin.x >> object->spin.y >> object->spin.z >> object->spin.w);
+        else if (object && keyword == "end")
+        {
+            valid = !object->mesh.empty() && !object->textures[0].empty();
+            object->UpdateModelMatrix();
+            object = nullptr;
+        }
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            std::cout << filename << ":" << lineNumber << ": invalid scene line: " << line << std::endl;
+            return false;
+        }
+    }
+
+    if (object || primitive)
+    {
+        std::cout << filename << ": " << (object ? "object " + object->name : "primitive " + primitive->name) << " is missing its 'end'" << std::endl;
+        return false;
+    }
+
+    // Every referenced texture has to be declared
+    for (const SceneObject& o : scene.objects)
+        for (const std::string& texture : o.textures)
+            if (!texture.empty() && scene.FindTexture(texture) < 0)
+            {
+                std::cout << filename << ": object " << o.name << " uses undeclared texture " << texture << std::endl;
+                return false;
+            }
+
+    return true;
+}
+
+#endif
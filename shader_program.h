@@ -0,0 +1,301 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <iostream>         // cout
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "program_cache.h"  // ProgramBinaryCache
+
+/*
+ * Linked GLSL program with its uniforms, uniform blocks and vertex inputs reflected once at link time.
+ *
+ * Look locations up with Uniform()/UniformBlock() while setting up and keep the
+ * results; nothing here talks to the driver after Build() returns.
+ */
+class ShaderProgram
+{
+public:
+    GLuint id = 0;
+
+    // Compiles and links the program, then reflects its active uniforms and blocks.
+    // defines (e.g. "#define SHADOWS 1\n") go right after each #version line; with a cache,
+    // a binary stored by an earlier run is used instead of compiling when the driver accepts it.
+    bool Build(const char* vtxShaderSource, const char* fragShaderSource, const ProgramBinaryCache* cache = nullptr, const char* defines = nullptr)
+    {
+        // Compilation and linkage error reporting
+        int success = 0;
+        char infoLog[512];
+
+        uint64_t cacheKey = 0;
+        if (cache && !cache->Supported())
+            cache = nullptr;
+        if (cache)
+        {
+            cacheKey = cache->Key(vtxShaderSource, fragShaderSource, defines);
+            id = glCreateProgram();
+            if (cache->Load(cacheKey, id))
+            {
+                Reflect();
+                return true;
+            }
+            glDeleteProgram(id);
+            id = 0;
+        }
+
+        std::string vertexSource = WithDefines(vtxShaderSource, defines);
+        std::string fragmentSource = WithDefines(fragShaderSource, defines);
+        const char* vertexText = vertexSource.c_str();
+        const char* fragmentText = fragmentSource.c_str();
+
+        // Create the vertex and fragment shader objects
+        GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
+        GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+
+        // Retrive the shader source
+        glShaderSource(vertexShaderId, 1, &vertexText, NULL);
+        glShaderSource(fragmentShaderId, 1, &fragmentText, NULL);
+
+        // Compile the vertex shader, and print compilation errors (if any)
+        glCompileShader(vertexShaderId);
+        glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(vertexShaderId, sizeof(infoLog), NULL, infoLog);
+            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            glDeleteShader(vertexShaderId);
+            glDeleteShader(fragmentShaderId);
+            return false;
+        }
+
+        // Compile the fragment shader, and print compilation errors (if any)
+        glCompileShader(fragmentShaderId);
+        glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            glDeleteShader(vertexShaderId);
+            glDeleteShader(fragmentShaderId);
+            return false;
+        }
+
+        // Attach compiled shaders and link; the shader objects are not needed afterwards
+        id = glCreateProgram();
+        if (cache)
+            glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(id, vertexShaderId);
+        glAttachShader(id, fragmentShaderId);
+        glLinkProgram(id);
+        glDetachShader(id, vertexShaderId);
+        glDetachShader(id, fragmentShaderId);
+        glDeleteShader(vertexShaderId);
+        glDeleteShader(fragmentShaderId);
+
+        // check for linking errors
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(id, sizeof(infoLog), NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            Destroy();
+            return false;
+        }
+
+        if (cache)
+            cache->Store(cacheKey, id);
+        Reflect();
+        return true;
+    }
+
+    void Use() const
+    {
+        glUseProgram(id);
+    }
+
+    // Location of a default-block uniform, or -1 when the linker removed it
+    GLint Uniform(const std::string& name) const
+    {
+        auto it = mUniforms.find(name);
+        return it != mUniforms.end() ? it->second : -1;
+    }
+
+    // Index of a uniform block, or -1 when it is not active
+    GLint UniformBlock(const std::string& name) const
+    {
+        auto it = mUniformBlocks.find(name);
+        return it != mUniformBlocks.end() ? it->second : -1;
+    }
+
+    // Bit n is set when the vertex shader reads attribute location n (locations below 32)
+    uint32_t ActiveAttributeMask() const
+    {
+        return mActiveAttributes;
+    }
+
+    void Destroy()
+    {
+        glDeleteProgram(id);
+        id = 0;
+        mUniforms.clear();
+        mUniformBlocks.clear();
+        mActiveAttributes = 0;
+    }
+
+private:
+    std::unordered_map<std::string, GLint> mUniforms;
+    std::unordered_map<std::string, GLint> mUniformBlocks;
+    uint32_t mActiveAttributes = 0;
+
+    // Inserts defines after the #version line, which has to stay first
+    static std::string WithDefines(const char* source, const char* defines)
+    {
+        std::string text(source);
+        if (!defines || !*defines)
+            return text;
+        std::string block = std::string("\n") + defines + "\n";
+        size_t version = text.find("#version");
+        if (version == std::string::npos)
+            return block + text;
+        size_t lineEnd = text.find('\n', version);
+        return text.insert(lineEnd == std::string::npos ? text.size() : lineEnd, block);
+    }
+
+    // Number of consecutive attribute locations a vertex input of this type occupies
+    static GLint AttributeLocations(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_FLOAT_MAT2: case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: return 2;
+        case GL_FLOAT_MAT3: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT3x4: return 3;
+        case GL_FLOAT_MAT4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3: return 4;
+        default: return 1;
+        }
+    }
+
+    void Reflect()
+    {
+        mUniforms.clear();
+        mUniformBlocks.clear();
+
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength, '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(id, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+
+            // Members of uniform blocks have no location; they are reached through the block
+            std::string uniformName(name.c_str(), length);
+            GLint location = glGetUniformLocation(id, uniformName.c_str());
+            if (location < 0)
+                continue;
+
+            mUniforms[uniformName] = location;
+            // Arrays are reported as "name[0]"; make them reachable by their plain name too
+            size_t bracket = uniformName.find('[');
+            if (bracket != std::string::npos)
+                mUniforms[uniformName.substr(0, bracket)] = location;
+        }
+
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        name.assign(maxLength, '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(id, (GLuint)i, maxLength, &length, &name[0]);
+            mUniformBlocks[std::string(name.c_str(), length)] = i;
+        }
+
+        // Vertex inputs the linker kept; built-ins such as gl_VertexID report location -1
+        mActiveAttributes = 0;
+        glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        name.assign(maxLength, '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(id, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+            GLint location = glGetAttribLocation(id, std::string(name.c_str(), length).c_str());
+            for (GLint slot = 0; location >= 0 && slot < size * AttributeLocations(type); ++slot)
+                if (location + slot < 32)
+                    mActiveAttributes |= 1u << (location + slot);
+        }
+    }
+};
+
+
+/*
+ * std140 uniform buffer holding the camera matrices. It is bound once to
+ * CameraUniformBuffer::BINDING and shared by every program that declares
+ *
+ *     layout(std140, binding = 0) uniform CameraBlock { mat4 view; mat4 projection; };
+ */
+class CameraUniformBuffer
+{
+public:
+    static const GLuint BINDING = 0;
+
+    // Matches the std140 layout of CameraBlock (two column-major mat4s, no padding)
+    struct Block
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+
+    void Create()
+    {
+        glGenBuffers(1, &mBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, mBuffer);
+    }
+
+    // Uploads both matrices in a single call; done once per frame
+    void Update(const glm::mat4& view, const glm::mat4& projection)
+    {
+        Block block = { view, projection };
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // Same, skipped while version matches the last uploaded one (see ViewState::Version)
+    void Update(const glm::mat4& view, const glm::mat4& projection, unsigned version)
+    {
+        if (mUploaded && version == mVersion)
+            return;
+        Update(view, projection);
+        mVersion = version;
+        mUploaded = true;
+    }
+
+    void Destroy()
+    {
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+        mUploaded = false;
+    }
+
+private:
+    GLuint mBuffer = 0;
+    unsigned mVersion = 0;
+    bool mUploaded = false;
+};
+
+#endif
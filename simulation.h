@@ -0,0 +1,185 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cmath>            // floor
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+// Seconds on the steady clock that every simulation tick and render frame is stamped with
+inline double SimulationNow()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+
+/*
+ * Hands the latest value from one producer thread to one consumer thread
+ * without locks or waiting. The producer fills Back() and calls Publish();
+ * the consumer calls Update() and reads Front(), which stays untouched until
+ * its next Update(). Values published in between are skipped, not queued.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+    // Producer side
+    T& Back()
+    {
+        return mSlots[mBack];
+    }
+
+    void Publish()
+    {
+        mBack = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side; true when Front() changed
+    bool Update()
+    {
+        if (!(mMiddle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& Front() const
+    {
+        return mSlots[mFront];
+    }
+
+private:
+    static const unsigned INDEX = 3;
+    static const unsigned FRESH = 4;        // Set while the middle slot holds a value the consumer has not taken
+
+    T mSlots[3];
+    unsigned mBack = 0;                     // Producer's slot
+    unsigned mFront = 1;                    // Consumer's slot
+    std::atomic<unsigned> mMiddle{ 2 };     // The slot in between, plus FRESH
+};
+
+
+/*
+ * Schedule of fixed-length simulation ticks on the SimulationNow() clock.
+ *
+ *     double tickTime;
+ *     while (timestep.NextTick(SimulationNow(), tickTime))
+ *         Tick(tickTime);
+ *
+ * Every tick advances the simulation by Step() seconds, however often the
+ * caller polls. After a long stall at most maxCatchUp ticks are run back to
+ * back; the rest are dropped, so the simulation slows down instead of
+ * spiraling into ever longer frames.
+ */
+class FixedTimestep
+{
+public:
+    explicit FixedTimestep(double tickRate = 60.0, unsigned maxCatchUp = 5)
+        : mStep(1.0 / tickRate), mMaxCatchUp(maxCatchUp)
+    {
+    }
+
+    // Makes the first tick due at now
+    void Reset(double now)
+    {
+        mNext = now;
+        mCatchUp = 0;
+    }
+
+    // Yields the time of the next tick due by now, oldest first; false once none is left
+    bool NextTick(double now, double& tickTime)
+    {
+        if (mNext > now)
+        {
+            mCatchUp = 0;
+            return false;
+        }
+        if (mCatchUp == mMaxCatchUp)
+        {
+            // Skip to the first tick after now
+            double skipped = std::floor((now - mNext) / mStep) + 1.0;
+            mNext += skipped * mStep;
+            mDropped += (unsigned)skipped;
+            mCatchUp = 0;
+            return false;
+        }
+
+        tickTime = mNext;
+        mNext += mStep;
+        ++mCatchUp;
+        return true;
+    }
+
+    double Step() const
+    {
+        return mStep;
+    }
+
+    double NextTickTime() const
+    {
+        return mNext;
+    }
+
+    // Ticks skipped because the caller fell too far behind
+    unsigned Dropped() const
+    {
+        return mDropped;
+    }
+
+private:
+    double mStep;
+    unsigned mMaxCatchUp;
+    double mNext = 0.0;
+    unsigned mCatchUp = 0;      // Ticks run back to back so far
+    unsigned mDropped = 0;
+};
+
+
+// Runs a FixedTimestep's ticks on a thread of its own, sleeping in between
+class SimulationThread
+{
+public:
+    ~SimulationThread()
+    {
+        Stop();
+    }
+
+    // tick(tickTime) runs on the new thread; timestep belongs to it until Stop()
+    void Start(FixedTimestep& timestep, std::function<void(double)> tick)
+    {
+        mStop = false;
+        mThread = std::thread([this, &timestep, tick]()
+        {
+            while (!mStop.load(std::memory_order_relaxed))
+            {
+                double tickTime;
+                while (timestep.NextTick(SimulationNow(), tickTime))
+                    tick(tickTime);
+
+                double wait = timestep.NextTickTime() - SimulationNow();
+                if (wait > 0.0)
+                    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            }
+        });
+    }
+
+    void Stop()
+    {
+        mStop = true;
+        if (mThread.joinable())
+            mThread.join();
+    }
+
+    bool Running() const
+    {
+        return mThread.joinable();
+    }
+
+private:
+    std::thread mThread;
+    std::atomic<bool> mStop{ false };
+};
+
+#endif
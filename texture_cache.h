@@ -0,0 +1,344 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <iostream>         // cout
+#include <cstdio>           // fopen, fread, fwrite, rename
+#include <cstdint>
+#include <cstring>          // memcmp
+#include <algorithm>        // min, max, swap_ranges
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>       // stat
+
+#include "stb_image.h"      // Image loading Utility functions
+#include "mapped_file.h"
+#include "texture_compress.h"
+
+/*
+ * Baked texture cache.
+ *
+ * The first time an image is loaded it is decoded, flipped for OpenGL and
+ * reduced into its full mip chain, and the result is written next to the
+ * source as "<image>.texcache", or "<image>.bc.texcache" when the levels are
+ * block compressed (see texture_compress.h). Later runs map that file and
+ * upload the levels straight from the mapping. The cache records the size,
+ * modification time and hash of the source. A warm start only stats the image;
+ * it is read and hashed only when its size or time changed, so editing it
+ * rebakes the cache and merely touching it restamps the existing one.
+ *
+ *     TextureCacheHeader
+ *     TextureCacheLevel[levelCount]   (offsets are from the start of the file)
+ *     level data, largest level first
+ */
+const char TEXTURE_CACHE_MAGIC[4] = { 'T', 'X', 'C', 'H' };
+const uint32_t TEXTURE_CACHE_VERSION = 3;
+
+// Identifies a version of the source image without reading it
+struct TextureSourceStamp
+{
+    uint64_t size;
+    int64_t modified;       // Nanoseconds on Linux, seconds elsewhere
+};
+
+struct TextureCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    TextureSourceStamp source;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t format;        // TextureFormat of every level
+    uint32_t levelCount;
+};
+
+struct TextureCacheLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+
+// FNV-1a, 64 bit
+inline uint64_t HashBytes(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+inline bool StatTextureSource(const std::string& filename, TextureSourceStamp& stamp)
+{
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0)
+        return false;
+    stamp.size = (uint64_t)info.st_size;
+#ifdef __linux__
+    stamp.modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#else
+    stamp.modified = (int64_t)info.st_mtime;
+#endif
+    return true;
+}
+
+
+// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
+inline void flipImageVertically(unsigned char* image, int width, int height, int channels)
+{
+    size_t rowSize = (size_t)width * channels;
+    for (int j = 0; j < height / 2; ++j)
+    {
+        unsigned char* row1 = image + j * rowSize;
+        unsigned char* row2 = image + (height - 1 - j) * rowSize;
+        std::swap_ranges(row1, row1 + rowSize, row2);
+    }
+}
+
+
+/*
+ * A texture ready for upload: every mip level, already flipped.
+ * The pixels live either in a mapped cache file or, right after baking, in storage.
+ */
+struct BakedTexture
+{
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    TextureFormat format = TEXTURE_FORMAT_RAW;
+    std::vector<TextureCacheLevel> levels;
+    const unsigned char* data = nullptr;    // Base that the level offsets are relative to; nullptr when loading failed
+
+    std::unique_ptr<MappedFile> mapping;
+    std::vector<unsigned char> storage;
+
+    // Bytes from the first level to the end of the last one
+    size_t PixelSize() const
+    {
+        return levels.empty() ? 0 : (size_t)(levels.back().offset + levels.back().size - levels.front().offset);
+    }
+};
+
+
+// Size of the header and level table, rounded up so level data starts 16-byte aligned
+inline size_t TextureCacheDataOffset(size_t levelCount)
+{
+    size_t size = sizeof(TextureCacheHeader) + levelCount * sizeof(TextureCacheLevel);
+    return (size + 15) & ~(size_t)15;
+}
+
+
+// Appends the mip chain of a flipped image to texture.storage, level 0 included
+inline void BuildMipChain(const unsigned char* pixels, int width, int height, int channels, BakedTexture& texture)
+{
+    int levelCount = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levelCount;
+
+    size_t offset = TextureCacheDataOffset(levelCount);
+    texture.levels.clear();
+    for (int level = 0, w = width, h = height; level < levelCount; ++level)
+    {
+        TextureCacheLevel entry = { (uint32_t)w, (uint32_t)h, offset, (uint64_t)w * h * channels };
+        texture.levels.push_back(entry);
+        offset += (entry.size + 15) & ~(uint64_t)15;
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+
+    texture.storage.assign(offset, 0);
+    memcpy(texture.storage.data() + texture.levels[0].offset, pixels, texture.levels[0].size);
+
+    // 2x2 box filter; odd edges reuse their last row or column
+    for (int level = 1; level < levelCount; ++level)
+    {
+        const TextureCacheLevel& source = texture.levels[level - 1];
+        const TextureCacheLevel& target = texture.levels[level];
+        const unsigned char* src = texture.storage.data() + source.offset;
+        unsigned char* dst = texture.storage.data() + target.offset;
+        size_t srcRow = (size_t)source.width * channels;
+
+        for (uint32_t y = 0; y < target.height; ++y)
+        {
+            const unsigned char* row0 = src + std::min(2 * y, source.height - 1) * srcRow;
+            const unsigned char* row1 = src + std::min(2 * y + 1, source.height - 1) * srcRow;
+            for (uint32_t x = 0; x < target.width; ++x)
+            {
+                size_t x0 = std::min(2 * x, source.width - 1) * channels;
+                size_t x1 = std::min(2 * x + 1, source.width - 1) * channels;
+                for (int c = 0; c < channels; ++c)
+                    *dst++ = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+
+    texture.width = width;
+    texture.height = height;
+    texture.channels = channels;
+    texture.data = texture.storage.data();
+}
+
+
+// Replaces the uncompressed levels in texture.storage with their block compressed form
+inline void CompressMipChain(TextureFormat format, BakedTexture& texture)
+{
+    std::vector<TextureCacheLevel> levels = texture.levels;
+    size_t offset = levels.front().offset;
+    for (TextureCacheLevel& level : levels)
+    {
+        level.offset = offset;
+        level.size = CompressedImageSize(format, level.width, level.height);
+        offset += (level.size + 15) & ~(uint64_t)15;
+    }
+
+    std::vector<unsigned char> storage(offset, 0);
+    for (size_t i = 0; i < levels.size(); ++i)
+        CompressImage(texture.storage.data() + texture.levels[i].offset, levels[i].width, levels[i].height, texture.channels,
+            format, storage.data() + levels[i].offset);
+
+    texture.levels.swap(levels);
+    texture.storage.swap(storage);
+    texture.format = format;
+    texture.data = texture.storage.data();
+}
+
+
+// Writes the header and level table into texture.storage and saves it; the rename keeps readers from seeing half a file
+inline bool WriteTextureCache(const std::string& path, const TextureSourceStamp& stamp, uint64_t sourceHash, BakedTexture& texture)
+{
+    TextureCacheHeader header;
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.source = stamp;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.channels = texture.channels;
+    header.format = texture.format;
+    header.levelCount = (uint32_t)texture.levels.size();
+
+    memcpy(texture.storage.data(), &header, sizeof(header));
+    memcpy(texture.storage.data() + sizeof(header), texture.levels.data(), texture.levels.size() * sizeof(TextureCacheLevel));
+
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(texture.storage.data(), 1, texture.storage.size(), file) == texture.storage.size();
+    written = fclose(file) == 0 && written;
+
+    remove(path.c_str());   // rename does not replace an existing file on Windows
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+// Maps a cache file and checks that it was baked from a source with this size and modification time
+inline bool ReadTextureCache(const std::string& path, const TextureSourceStamp& stamp, BakedTexture& texture)
+{
+    std::unique_ptr<MappedFile> mapping(new MappedFile());
+    if (!mapping->Open(path.c_str()) || mapping->Size() < sizeof(TextureCacheHeader))
+        return false;
+
+    TextureCacheHeader header;
+    memcpy(&header, mapping->Data(), sizeof(header));
+    if (memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != TEXTURE_CACHE_VERSION
+        || header.source.size != stamp.size || header.source.modified != stamp.modified || header.levelCount == 0
+        || (header.format != TEXTURE_FORMAT_RAW && header.format != TEXTURE_FORMAT_BC1 && header.format != TEXTURE_FORMAT_BC3)
+        || mapping->Size() < TextureCacheDataOffset(header.levelCount))
+        return false;
+
+    texture.levels.resize(header.levelCount);
+    memcpy(texture.levels.data(), mapping->Data() + sizeof(header), header.levelCount * sizeof(TextureCacheLevel));
+    for (const TextureCacheLevel& level : texture.levels)
+        if (level.offset + level.size > mapping->Size())
+            return false;
+
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.channels = header.channels;
+    texture.format = (TextureFormat)header.format;
+    texture.data = mapping->Data();
+    texture.mapping = std::move(mapping);
+    return true;
+}
+
+
+// When a cache was baked from a source with this hash, records the source's new size and modification time in it.
+// Done before mapping, as Windows does not allow writing to a mapped file.
+inline bool RestampTextureCache(const std::string& path, uint64_t sourceHash, const TextureSourceStamp& stamp)
+{
+    FILE* file = fopen(path.c_str(), "r+b");
+    if (!file)
+        return false;
+    TextureCacheHeader header;
+    bool restamped = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == TEXTURE_CACHE_VERSION
+        && header.sourceHash == sourceHash;
+    header.source = stamp;
+    restamped = restamped && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    return fclose(file) == 0 && restamped;
+}
+
+
+// Loads an image through its cache, baking the cache when it is missing or stale.
+// With compress set, RGB images are baked to BC1 and RGBA images to BC3.
+// Safe to call from worker threads as long as no two of them load the same file.
+inline bool LoadBakedTexture(const std::string& filename, bool compress, BakedTexture& texture)
+{
+    TextureSourceStamp stamp;
+    if (!StatTextureSource(filename, stamp))
+        return false;
+    std::string cachePath = filename + (compress ? ".bc.texcache" : ".texcache");
+    if (ReadTextureCache(cachePath, stamp, texture))
+        return true;
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+    std::vector<unsigned char> source;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0)
+    {
+        source.resize((size_t)size);
+        source.resize(fread(source.data(), 1, source.size(), file));
+    }
+    fclose(file);
+    if (source.empty())
+        return false;
+
+    // The stamp changed; only a change in the bytes themselves needs a rebake
+    uint64_t sourceHash = HashBytes(source.data(), source.size());
+    if (RestampTextureCache(cachePath, sourceHash, stamp) && ReadTextureCache(cachePath, stamp, texture))
+        return true;
+
+    int width, height, channels;
+    unsigned char* image = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 0);
+    if (!image)
+        return false;
+    flipImageVertically(image, width, height, channels);
+    BuildMipChain(image, width, height, channels, texture);
+    stbi_image_free(image);
+    if (compress && (channels == 3 || channels == 4))
+        CompressMipChain(channels == 4 ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1, texture);
+
+    if (!WriteTextureCache(cachePath, stamp, sourceHash, texture))
+        std::cout << "Could not write texture cache " << cachePath << std::endl;
+    return true;
+}
+
+#endif
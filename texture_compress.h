@@ -0,0 +1,221 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <cstdint>
+#include <cstdlib>          // abs
+#include <cmath>            // abs
+#include <cstring>          // memcpy
+#include <algorithm>        // min, max, swap
+
+/*
+ * S3TC block compression for baked textures.
+ *
+ * BC1 (DXT1) stores a 4x4 block of RGB in 8 bytes, BC3 (DXT5) stores RGBA in
+ * 16 bytes, against 48 and 64 bytes uncompressed. The colour endpoints are the
+ * extremes of the block along its principal axis, which is what the fast modes
+ * of the common encoders do; good enough for the diffuse maps used here.
+ */
+enum TextureFormat
+{
+    TEXTURE_FORMAT_RAW = 0,     // Uncompressed RGB8 or RGBA8, by channel count
+    TEXTURE_FORMAT_BC1 = 1,
+    TEXTURE_FORMAT_BC3 = 3,
+};
+
+// Bytes per 4x4 block
+inline size_t CompressedBlockSize(TextureFormat format)
+{
+    return format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+inline size_t CompressedImageSize(TextureFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * CompressedBlockSize(format);
+}
+
+
+namespace texture_compress
+{
+    inline uint16_t PackColor565(const float color[3])
+    {
+        int r = std::min(31, std::max(0, (int)(color[0] * 31.0f / 255.0f + 0.5f)));
+        int g = std::min(63, std::max(0, (int)(color[1] * 63.0f / 255.0f + 0.5f)));
+        int b = std::min(31, std::max(0, (int)(color[2] * 31.0f / 255.0f + 0.5f)));
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void UnpackColor565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // 16 RGBA texels in, 8 bytes of BC1 colour block out
+    inline void EncodeColorBlock(const unsigned char block[64], unsigned char* out)
+    {
+        // Principal axis of the colours by power iteration on their covariance
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+                mean[c] += block[i * 4 + c];
+        for (int c = 0; c < 3; ++c)
+            mean[c] /= 16.0f;
+
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i)
+        {
+            float r = block[i * 4 + 0] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float x = axis[0] * covariance[0] + axis[1] * covariance[1] + axis[2] * covariance[2];
+            float y = axis[0] * covariance[1] + axis[1] * covariance[3] + axis[2] * covariance[4];
+            float z = axis[0] * covariance[2] + axis[1] * covariance[4] + axis[2] * covariance[5];
+            float length = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        // Endpoints are the texels furthest apart along the axis
+        int minIndex = 0, maxIndex = 0;
+        float minDot = 1e30f, maxDot = -1e30f;
+        for (int i = 0; i < 16; ++i)
+        {
+            float dot = block[i * 4 + 0] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+            if (dot < minDot) { minDot = dot; minIndex = i; }
+            if (dot > maxDot) { maxDot = dot; maxIndex = i; }
+        }
+
+        float maxColor[3] = { (float)block[maxIndex * 4 + 0], (float)block[maxIndex * 4 + 1], (float)block[maxIndex * 4 + 2] };
+        float minColor[3] = { (float)block[minIndex * 4 + 0], (float)block[minIndex * 4 + 1], (float)block[minIndex * 4 + 2] };
+        uint16_t color0 = PackColor565(maxColor);
+        uint16_t color1 = PackColor565(minColor);
+        if (color0 < color1)
+            std::swap(color0, color1);  // color0 > color1 selects the four colour mode
+
+        int palette[4][3];
+        UnpackColor565(color0, palette[0]);
+        UnpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0, bestError = 1 << 30;
+                for (int p = 0; p < 4; ++p)
+                {
+                    int dr = block[i * 4 + 0] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError) { bestError = error; best = p; }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+
+        out[0] = (unsigned char)(color0 & 0xFF);
+        out[1] = (unsigned char)(color0 >> 8);
+        out[2] = (unsigned char)(color1 & 0xFF);
+        out[3] = (unsigned char)(color1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            out[4 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    // 16 RGBA texels in, 8 bytes of BC3 alpha block out
+    inline void EncodeAlphaBlock(const unsigned char block[64], unsigned char* out)
+    {
+        int alpha0 = 0, alpha1 = 255;
+        for (int i = 0; i < 16; ++i)
+        {
+            alpha0 = std::max(alpha0, (int)block[i * 4 + 3]);
+            alpha1 = std::min(alpha1, (int)block[i * 4 + 3]);
+        }
+
+        // alpha0 > alpha1 selects eight interpolated values; equal endpoints leave every index at 0
+        int palette[8] = { alpha0, alpha1 };
+        for (int p = 1; p < 7; ++p)
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+        uint64_t indices = 0;
+        if (alpha0 != alpha1)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0, bestError = 256;
+                for (int p = 0; p < 8; ++p)
+                {
+                    int error = std::abs(block[i * 4 + 3] - palette[p]);
+                    if (error < bestError) { bestError = error; best = p; }
+                }
+                indices |= (uint64_t)best << (3 * i);
+            }
+        }
+
+        out[0] = (unsigned char)alpha0;
+        out[1] = (unsigned char)alpha1;
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    // Encodes block rows [firstRow, lastRow) of an image
+    inline void EncodeBlockRows(const unsigned char* pixels, int width, int height, int channels, TextureFormat format,
+        int firstRow, int lastRow, unsigned char* out)
+    {
+        int blocksWide = (width + 3) / 4;
+        size_t blockSize = CompressedBlockSize(format);
+        unsigned char block[64];
+
+        for (int by = firstRow; by < lastRow; ++by)
+        {
+            for (int bx = 0; bx < blocksWide; ++bx)
+            {
+                // Gather as RGBA, repeating the last row and column past the edge of the image
+                for (int y = 0; y < 4; ++y)
+                {
+                    const unsigned char* row = pixels + (size_t)std::min(by * 4 + y, height - 1) * width * channels;
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const unsigned char* texel = row + (size_t)std::min(bx * 4 + x, width - 1) * channels;
+                        unsigned char* target = block + (y * 4 + x) * 4;
+                        target[0] = texel[0];
+                        target[1] = texel[1];
+                        target[2] = texel[2];
+                        target[3] = channels == 4 ? texel[3] : 255;
+                    }
+                }
+
+                unsigned char* blockOut = out + ((size_t)by * blocksWide + bx) * blockSize;
+                if (format == TEXTURE_FORMAT_BC3)
+                {
+                    EncodeAlphaBlock(block, blockOut);
+                    EncodeColorBlock(block, blockOut + 8);
+                }
+                else
+                    EncodeColorBlock(block, blockOut);
+            }
+        }
+    }
+}
+
+
+// Compresses one image into CompressedImageSize(format, width, height) bytes at out.
+// Runs on the calling thread; the texture loader already compresses one file per worker.
+inline void CompressImage(const unsigned char* pixels, int width, int height, int channels, TextureFormat format,
+    unsigned char* out)
+{
+    texture_compress::EncodeBlockRows(pixels, width, height, channels, format, 0, (height + 3) / 4, out);
+}
+
+#endif
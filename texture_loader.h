@@ -0,0 +1,273 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <iostream>         // cout
+#include <cstring>          // memcpy
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>        // GLEW library
+
+#include "texture_cache.h"  // Baked, pre-flipped images with their mip chains
+
+/*
+ * Decodes images on a pool of worker threads and uploads them on the GL thread.
+ *
+ * Request() returns a texture name right away, holding a 1x1 placeholder, so
+ * draws can reference it before the image exists. Workers map the image's
+ * baked cache, or decode and bake it on a miss (see texture_cache.h); Update(),
+ * called once per frame on the thread owning the context, copies finished mip
+ * chains into a pixel unpack buffer and re-specifies the same texture from it. Nothing that already refers to the texture has to change.
+ */
+class TextureLoader
+{
+public:
+    ~TextureLoader()
+    {
+        Destroy();
+    }
+
+    // Starts the workers; 0 picks one less than the number of hardware threads
+    void Create(unsigned workerCount = 0)
+    {
+        // Bake to BC1/BC3 when the driver can sample them, plain RGB8/RGBA8 otherwise
+        mCompress = GLEW_EXT_texture_compression_s3tc != 0;
+
+        if (workerCount == 0)
+        {
+            unsigned hardware = std::thread::hardware_concurrency();
+            workerCount = hardware > 1 ? hardware - 1 : 1;
+        }
+
+        mStop = false;
+        for (unsigned i = 0; i < workerCount; ++i)
+            mWorkers.emplace_back(&TextureLoader::WorkerLoop, this);
+
+        glGenBuffers(PBO_COUNT, mPixelBuffers);
+    }
+
+    // Stops the workers and drops unfinished work; the textures belong to the caller
+    void Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWorkAvailable.notify_all();
+        for (std::thread& worker : mWorkers)
+            worker.join();
+        mWorkers.clear();
+
+        mDecoded.clear();
+        mRequests.clear();
+        mPending = 0;
+
+        if (mPixelBuffers[0])
+            glDeleteBuffers(PBO_COUNT, mPixelBuffers);
+        memset(mPixelBuffers, 0, sizeof(mPixelBuffers));
+    }
+
+    // Creates the texture with placeholder contents and queues its image for decoding
+    GLuint Request(const std::string& filename)
+    {
+        GLuint textureId = 0;
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+
+        // set the texture wrapping parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // set texture filtering parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRequests.push_back(Job{ textureId, filename });
+            ++mPending;
+        }
+        mWorkAvailable.notify_one();
+        return textureId;
+    }
+
+    // Uploads decoded images until about byteBudget bytes were sent (at least one image).
+    // Returns the number of textures that finished, successfully or not.
+    unsigned Update(size_t byteBudget = 16 * 1024 * 1024)
+    {
+        unsigned finished = 0;
+        size_t uploaded = 0;
+        while (uploaded < byteBudget)
+        {
+            Decoded decoded;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mDecoded.empty())
+                    break;
+                decoded = std::move(mDecoded.front());
+                mDecoded.pop_front();
+            }
+
+            uploaded += Upload(decoded);
+            ++finished;
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mPending;
+        }
+        return finished;
+    }
+
+    // Uploads everything that was requested, blocking until the workers are done.
+    // Returns false when any image failed to load since the last call.
+    bool Finish()
+    {
+        while (Pending() > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWorkDone.wait(lock, [this] { return !mDecoded.empty(); });
+            }
+            Update(~(size_t)0);
+        }
+
+        bool succeeded = mFailed == 0;
+        mFailed = 0;
+        return succeeded;
+    }
+
+    // Requested textures that still show their placeholder
+    unsigned Pending() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPending;
+    }
+
+private:
+    static const int PBO_COUNT = 3;
+
+    struct Job
+    {
+        GLuint textureId;
+        std::string filename;
+    };
+
+    struct Decoded
+    {
+        GLuint textureId = 0;
+        std::string filename;
+        BakedTexture texture;
+    };
+
+    std::vector<std::thread> mWorkers;
+    mutable std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    std::deque<Job> mRequests;
+    std::deque<Decoded> mDecoded;
+    unsigned mPending = 0;
+    unsigned mFailed = 0;
+    bool mStop = false;
+    bool mCompress = false;     // Read by the workers, only written before they start
+
+    // Cycled so a new upload never waits on the buffer the driver may still be reading
+    GLuint mPixelBuffers[PBO_COUNT] = {};
+    int mNextPixelBuffer = 0;
+
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWorkAvailable.wait(lock, [this] { return mStop || !mRequests.empty(); });
+                if (mStop)
+                    return;
+                job = mRequests.front();
+                mRequests.pop_front();
+            }
+
+            Decoded decoded;
+            decoded.textureId = job.textureId;
+            decoded.filename = job.filename;
+            if (!LoadBakedTexture(job.filename, mCompress, decoded.texture))
+                decoded.texture.data = nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mStop)
+                    return;
+                mDecoded.push_back(std::move(decoded));
+            }
+            mWorkDone.notify_all();
+        }
+    }
+
+    // Streams one mip chain through a pixel buffer into its texture; returns the bytes sent
+    size_t Upload(const Decoded& decoded)
+    {
+        const BakedTexture& texture = decoded.texture;
+        GLenum format = texture.channels == 3 ? GL_RGB : texture.channels == 4 ? GL_RGBA : 0;
+        if (!texture.data || !format)
+        {
+            if (!texture.data)
+                std::cout << "Failed to load texture " << decoded.filename << std::endl;
+            else
+                std::cout << "Not implemented to handle image with " << texture.channels << " channels: " << decoded.filename << std::endl;
+            ++mFailed;
+            return 0;
+        }
+
+        const unsigned char* pixels = texture.data + texture.levels.front().offset;
+        size_t size = texture.PixelSize();
+        GLuint pixelBuffer = mPixelBuffers[mNextPixelBuffer];
+        mNextPixelBuffer = (mNextPixelBuffer + 1) % PBO_COUNT;
+
+        // Orphan the buffer so mapping never stalls on an upload still in flight
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (staging)
+        {
+            memcpy(staging, pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+        {
+            // Mapping failed: fall back to a plain client memory upload
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        // Rows of RGB images are not necessarily 4-byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, decoded.textureId);
+        GLint levelCount = (GLint)texture.levels.size();
+        for (GLint level = 0; level < levelCount; ++level)
+        {
+            const TextureCacheLevel& entry = texture.levels[level];
+            size_t offset = (size_t)(entry.offset - texture.levels.front().offset);
+            const void* source = staging ? (const void*)offset : pixels + offset;
+            if (texture.format == TEXTURE_FORMAT_BC1)
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, entry.width, entry.height, 0, (GLsizei)entry.size, source);
+            else if (texture.format == TEXTURE_FORMAT_BC3)
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, entry.width, entry.height, 0, (GLsizei)entry.size, source);
+            else
+                glTexImage2D(GL_TEXTURE_2D, level, texture.channels == 3 ? GL_RGB8 : GL_RGBA8, entry.width, entry.height, 0,
+                    format, GL_UNSIGNED_BYTE, source);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        return size;
+    }
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <iostream>         // cout
+#include <GL/glew.h>        // GLEW library
+
+/*
+ * Buffer for data the CPU rewrites every frame, mapped once for the buffer's
+ * whole lifetime (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT).
+ *
+ * The storage is split into FRAME_COUNT regions used in turn. EndFrame() puts
+ * a fence behind the commands that read the current region; BeginFrame()
+ * waits on the fence of the region it is about to reuse, which normally has
+ * long been signaled. Writes through the mapped pointer need no flush or
+ * glBufferSubData, and the driver never has to orphan or copy the storage.
+ *
+ *     ring.BeginFrame();
+ *     GLintptr offset;
+ *     void* data = ring.Allocate(size, alignment, offset);
+ *     ...write data, draw with ring.Buffer() bound at offset...
+ *     ring.EndFrame();
+ */
+class UploadRing
+{
+public:
+    static const unsigned FRAME_COUNT = 3;
+
+    ~UploadRing()
+    {
+        Destroy();
+    }
+
+    // Allocates FRAME_COUNT regions of frameSize bytes each and maps them
+    bool Create(GLsizeiptr frameSize)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &mBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, frameSize * FRAME_COUNT, NULL, flags);
+        mMapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, frameSize * FRAME_COUNT, flags);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (!mMapped)
+        {
+            std::cout << "Failed to map a persistent buffer of " << frameSize * FRAME_COUNT << " bytes" << std::endl;
+            Destroy();
+            return false;
+        }
+
+        mFrameSize = frameSize;
+        mFrame = 0;
+        mUsed = 0;
+        return true;
+    }
+
+    void Destroy()
+    {
+        for (GLsync& fence : mFences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (mMapped)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            mMapped = nullptr;
+        }
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+        mFrameSize = 0;
+    }
+
+    // Grows every region to at least frameSize bytes; waits for the GPU to finish with all of them first.
+    // Call before the frame's first Allocate().
+    bool Reserve(GLsizeiptr frameSize)
+    {
+        if (frameSize <= mFrameSize)
+            return true;
+        for (GLsync fence : mFences)
+            Wait(fence);
+        Destroy();
+        return Create(frameSize);
+    }
+
+    // Moves to the next region, waiting until the GPU no longer reads it
+    void BeginFrame()
+    {
+        mFrame = (mFrame + 1) % FRAME_COUNT;
+        mUsed = 0;
+        GLsync& fence = mFences[mFrame];
+        if (fence)
+        {
+            if (Wait(fence))
+                ++mStalls;
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    // Reserves size bytes of the current region; nullptr when it does not fit.
+    // offset is the position of the returned memory in Buffer(), a multiple of alignment.
+    void* Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+    {
+        GLintptr start = mFrameSize * mFrame;
+        GLintptr aligned = (start + mUsed + alignment - 1) / alignment * alignment;
+        if (aligned + size > start + mFrameSize)
+            return nullptr;
+        mUsed = aligned + size - start;
+        offset = aligned;
+        return mMapped + aligned;
+    }
+
+    // Fences the current region behind every command issued so far
+    void EndFrame()
+    {
+        mFences[mFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLuint Buffer() const
+    {
+        return mBuffer;
+    }
+
+    GLsizeiptr FrameSize() const
+    {
+        return mFrameSize;
+    }
+
+    // Frames that had to wait for the GPU to release their region
+    unsigned Stalls() const
+    {
+        return mStalls;
+    }
+
+private:
+    GLuint mBuffer = 0;
+    unsigned char* mMapped = nullptr;
+    GLsizeiptr mFrameSize = 0;
+    unsigned mFrame = 0;
+    GLsizeiptr mUsed = 0;               // Bytes allocated from the current region
+    GLsync mFences[FRAME_COUNT] = {};
+    unsigned mStalls = 0;
+
+    // Blocks until the fence is signaled; true if it was not already
+    static bool Wait(GLsync fence)
+    {
+        if (!fence)
+            return false;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            return false;
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        return true;
+    }
+};
+
+#endif
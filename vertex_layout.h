@@ -0,0 +1,248 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <cstdint>
+#include <cstring>          // memcpy
+#include <vector>
+#include <GL/glew.h>        // GLEW library
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+/*
+ * Compile-time vertex layouts with packed attribute formats.
+ *
+ * A vertex type lists its attributes (location, meaning, storage format) as a
+ * VertexLayout; stride and offsets are computed at compile time. Strip() then
+ * drops every attribute the shader does not read, giving the PackedLayout that
+ * converts SourceVertex data and sets up the VAO:
+ *
+ *     struct ChestVertex
+ *     {
+ *         typedef VertexLayout<
+ *             VertexAttrib<0, VertexSemantic::Position, AttribFormat::Float3>,
+ *             VertexAttrib<2, VertexSemantic::TexCoord, AttribFormat::Half2>> Layout;
+ *     };
+ *     PackedLayout layout = ChestVertex::Layout::Strip(program.ActiveAttributeMask());
+ */
+
+// Full-precision vertex the mesh generators produce; packed before upload
+struct SourceVertex
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec4 color = glm::vec4(1.0f);
+    glm::vec2 texCoord = glm::vec2(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+};
+
+enum class VertexSemantic { Position, Color, TexCoord, Normal };
+
+enum class AttribFormat
+{
+    Float2,             // 8 bytes
+    Float3,             // 12 bytes
+    Float4,             // 16 bytes
+    Half2,              // 4 bytes, IEEE half floats
+    Half4,              // 8 bytes
+    UNorm8x4,           // 4 bytes, [0, 1] mapped to 0..255
+    SNorm10_10_10_2     // 4 bytes, [-1, 1] xyz in 10 bits each, w in 2 bits
+};
+
+// Size of one attribute in bytes
+constexpr GLuint AttribFormatSize(AttribFormat format)
+{
+    return format == AttribFormat::Float2 ? 8
+         : format == AttribFormat::Float3 ? 12
+         : format == AttribFormat::Float4 ? 16
+         : format == AttribFormat::Half4 ? 8
+         : 4;
+}
+
+// Float to IEEE 754 half, round to nearest even; overflow saturates to infinity
+inline uint16_t PackHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)                      // Inf / NaN
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)                                     // Too large
+        return (uint16_t)(sign | 0x7C00);
+    if (exponent <= 0)                                      // Denormal or zero
+    {
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        ++half;                                             // May carry into the exponent, which is correct
+    return (uint16_t)half;
+}
+
+inline uint32_t PackUNorm8x4(const glm::vec4& v)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 4; ++i)
+        packed |= (uint32_t)(glm::clamp(v[i], 0.0f, 1.0f) * 255.0f + 0.5f) << (8 * i);
+    return packed;
+}
+
+// GL_INT_2_10_10_10_REV layout: x in bits 0-9, y in 10-19, z in 20-29, w in 30-31
+inline uint32_t PackSNorm10_10_10_2(const glm::vec4& v)
+{
+    auto pack = [](float value, float scale, uint32_t mask) {
+        float clamped = glm::clamp(value, -1.0f, 1.0f) * scale;
+        int32_t rounded = (int32_t)(clamped + (clamped >= 0.0f ? 0.5f : -0.5f));
+        return (uint32_t)rounded & mask;
+    };
+    return pack(v.x, 511.0f, 0x3FF) | (pack(v.y, 511.0f, 0x3FF) << 10)
+         | (pack(v.z, 511.0f, 0x3FF) << 20) | (pack(v.w, 1.0f, 0x3) << 30);
+}
+
+// One attribute of a vertex type
+struct AttribDesc
+{
+    GLuint location;
+    VertexSemantic semantic;
+    AttribFormat format;
+    GLuint offset;      // Offset within the vertex, in bytes
+};
+
+/*
+ * Attribute layout resolved at runtime, usually a VertexLayout with the
+ * attributes the shader ignores removed.
+ */
+struct PackedLayout
+{
+    std::vector<AttribDesc> attributes;
+    GLuint stride = 0;
+
+    // Converts source vertices to this layout, appending to out
+    void Pack(const SourceVertex* vertices, size_t count, std::vector<unsigned char>& out) const
+    {
+        size_t start = out.size();
+        out.resize(start + count * stride);
+        for (size_t i = 0; i < count; ++i)
+        {
+            unsigned char* vertex = &out[start + i * stride];
+            for (const AttribDesc& attribute : attributes)
+                PackAttribute(vertices[i], attribute, vertex + attribute.offset);
+        }
+    }
+
+    // Sets up the attribute pointers of the bound VAO for the bound GL_ARRAY_BUFFER
+    void Apply() const
+    {
+        for (const AttribDesc& attribute : attributes)
+        {
+            const void* offset = (const void*)(uintptr_t)attribute.offset;
+            switch (attribute.format)
+            {
+            case AttribFormat::Float2: glVertexAttribPointer(attribute.location, 2, GL_FLOAT, GL_FALSE, stride, offset); break;
+            case AttribFormat::Float3: glVertexAttribPointer(attribute.location, 3, GL_FLOAT, GL_FALSE, stride, offset); break;
+            case AttribFormat::Float4: glVertexAttribPointer(attribute.location, 4, GL_FLOAT, GL_FALSE, stride, offset); break;
+            case AttribFormat::Half2: glVertexAttribPointer(attribute.location, 2, GL_HALF_FLOAT, GL_FALSE, stride, offset); break;
+            case AttribFormat::Half4: glVertexAttribPointer(attribute.location, 4, GL_HALF_FLOAT, GL_FALSE, stride, offset); break;
+            case AttribFormat::UNorm8x4: glVertexAttribPointer(attribute.location, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, offset); break;
+            case AttribFormat::SNorm10_10_10_2: glVertexAttribPointer(attribute.location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offset); break;
+            }
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+
+private:
+    static void PackAttribute(const SourceVertex& vertex, const AttribDesc& attribute, unsigned char* out)
+    {
+        glm::vec4 value;
+        switch (attribute.semantic)
+        {
+        case VertexSemantic::Position: value = glm::vec4(vertex.position, 1.0f); break;
+        case VertexSemantic::Color: value = vertex.color; break;
+        case VertexSemantic::TexCoord: value = glm::vec4(vertex.texCoord.x, vertex.texCoord.y, 0.0f, 0.0f); break;
+        case VertexSemantic::Normal: value = glm::vec4(vertex.normal, 0.0f); break;
+        }
+
+        switch (attribute.format)
+        {
+        case AttribFormat::Float2:
+        case AttribFormat::Float3:
+        case AttribFormat::Float4:
+            memcpy(out, &value[0], AttribFormatSize(attribute.format));
+            break;
+        case AttribFormat::Half2:
+        case AttribFormat::Half4:
+        {
+            uint16_t halves[4] = { PackHalf(value.x), PackHalf(value.y), PackHalf(value.z), PackHalf(value.w) };
+            memcpy(out, halves, AttribFormatSize(attribute.format));
+            break;
+        }
+        case AttribFormat::UNorm8x4:
+        {
+            uint32_t packed = PackUNorm8x4(value);
+            memcpy(out, &packed, sizeof(packed));
+            break;
+        }
+        case AttribFormat::SNorm10_10_10_2:
+        {
+            uint32_t packed = PackSNorm10_10_10_2(value);
+            memcpy(out, &packed, sizeof(packed));
+            break;
+        }
+        }
+    }
+};
+
+// Attribute declaration: shader location, what it holds and how it is stored
+template <GLuint Location, VertexSemantic Semantic, AttribFormat Format>
+struct VertexAttrib
+{
+    static const GLuint location = Location;
+    static const VertexSemantic semantic = Semantic;
+    static const AttribFormat format = Format;
+    static const GLuint size = AttribFormatSize(Format);
+};
+
+// Attributes are laid out back to back in declaration order; every format is a multiple of 4 bytes
+template <typename... Attribs>
+struct VertexLayout
+{
+    static const GLuint Stride = (0 + ... + Attribs::size);
+    static const uint32_t LocationMask = (0u | ... | (1u << Attribs::location));
+
+    // The full layout, nothing stripped
+    static PackedLayout Full()
+    {
+        return Strip(~0u);
+    }
+
+    // Keeps only the attributes whose location is set in activeLocations, repacked tightly
+    static PackedLayout Strip(uint32_t activeLocations)
+    {
+        PackedLayout layout;
+        const AttribDesc declared[] = { AttribDesc{ Attribs::location, Attribs::semantic, Attribs::format, 0 }... };
+        for (const AttribDesc& attribute : declared)
+        {
+            if (!(activeLocations & (1u << attribute.location)))
+                continue;
+            layout.attributes.push_back(attribute);
+            layout.attributes.back().offset = layout.stride;
+            layout.stride += AttribFormatSize(attribute.format);
+        }
+        return layout;
+    }
+};
+
+#endif
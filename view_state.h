@@ -0,0 +1,75 @@
+#ifndef VIEW_STATE_H
+#define VIEW_STATE_H
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include "culling.h"        // Frustum
+
+/*
+ * Everything derived from the camera and the framebuffer: the view and
+ * projection matrices, their product and its inverse, and the frustum planes.
+ *
+ * Update() compares its inputs with the ones the current values were built
+ * from and only recomputes what depends on an input that changed. Version()
+ * increases whenever any output changes, so consumers (uniform buffers,
+ * cached culling results) can remember the version they last saw and skip
+ * their own work while it stays the same.
+ */
+class ViewState
+{
+public:
+    // cameraVersion must change whenever view does; makeProjection(ortho, width, height) builds the projection
+    template<typename ProjectionFunction>
+    bool Update(unsigned cameraVersion, const glm::mat4& view, bool ortho, int width, int height, ProjectionFunction makeProjection)
+    {
+        bool viewChanged = !mValid || cameraVersion != mCameraVersion;
+        bool projectionChanged = !mValid || ortho != mOrtho || width != mWidth || height != mHeight;
+        if (!viewChanged && !projectionChanged)
+            return false;
+
+        if (viewChanged)
+        {
+            mView = view;
+            mCameraVersion = cameraVersion;
+        }
+        if (projectionChanged)
+        {
+            mProjection = makeProjection(ortho, width, height);
+            mOrtho = ortho;
+            mWidth = width;
+            mHeight = height;
+        }
+
+        mViewProjection = mProjection * mView;
+        mInverseViewProjection = glm::inverse(mViewProjection);
+        mFrustum = Frustum(mViewProjection);
+        mValid = true;
+        ++mVersion;
+        return true;
+    }
+
+    const glm::mat4& View() const { return mView; }
+    const glm::mat4& Projection() const { return mProjection; }
+    const glm::mat4& ViewProjection() const { return mViewProjection; }
+    const glm::mat4& InverseViewProjection() const { return mInverseViewProjection; }
+    const Frustum& GetFrustum() const { return mFrustum; }
+    unsigned Version() const { return mVersion; }
+
+private:
+    glm::mat4 mView = glm::mat4(1.0f);
+    glm::mat4 mProjection = glm::mat4(1.0f);
+    glm::mat4 mViewProjection = glm::mat4(1.0f);
+    glm::mat4 mInverseViewProjection = glm::mat4(1.0f);
+    Frustum mFrustum;
+    unsigned mVersion = 0;
+
+    // Inputs the values above were built from
+    bool mValid = false;
+    unsigned mCameraVersion = 0;
+    bool mOrtho = false;
+    int mWidth = 0;
+    int mHeight = 0;
+};
+
+#endif